@@ -1,26 +1,36 @@
 #include "angel_can.h"
+#include "can_gateway.h"
+#include "can_history.h"
+#include "can_latency.h"
+#include "can_snapshot.h"
 #include "faults.h"
 #include <unordered_map>
-#include <algorithm>
 #include <cmath>
 
 using namespace std;
 
-static unordered_map<uint32_t, CanInbox *> allInboxes;
-static unordered_map<uint32_t, CanOutbox *> allOutboxes;
-static CAN_HANDLE *canHandleTypeDef;
+static CanBus defaultBus;
+
+typedef struct CanHandlerEntry {
+  CanHandler handler;
+  void *context;
+} CanHandlerEntry;
+
+static CanHandlerEntry handlers[CAN_MAX_HANDLERS];
 
 /**
  * Returns the struct associated with this ID
  * If no struct is found, returns nullptr
+ * @param bus Bus the inbox was registered on
  * @param id 11bit number
  * @return CanInbox* struct
  */
-static CanInbox *can_getInbox(uint32_t id) {
-  if (allInboxes.find(id) == allInboxes.end()) {
+static CanInbox *can_getInbox(CanBus *bus, uint32_t id) {
+  auto it = bus->inboxes.find(id);
+  if (it == bus->inboxes.end()) {
     return nullptr;
   } else {
-    return allInboxes.at(id);
+    return it->second;
   }
 }
 
@@ -83,11 +93,12 @@ static uint32_t num_to_dlc(uint8_t num) {
  * @param id ID of the CAN packet
  * @param dlc Length of the CAN packet
  * @param data Data of the CAN packet
- * @return 0 if successful, 1 if unsuccessful
+ * @return 0 if successful, CAN_SEND_FIFO_FULL if the Tx FIFO was full, otherwise the HAL error code
  */
-uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t *data) {
+uint32_t can_busSend(CanBus *bus, uint32_t id, uint8_t dlc, const uint8_t *data) {
+  CAN_HANDLE *canHandleTypeDef = bus->handle;
 #ifdef H7_SERIES
-  static FDCAN_TxHeaderTypeDef TxHeader;
+  FDCAN_TxHeaderTypeDef TxHeader = {}; // not static, frames can also be sent from the RX interrupt
   TxHeader.Identifier = id;
   TxHeader.IdType = (id > 0x7FF) ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
   TxHeader.TxFrameType = FDCAN_DATA_FRAME;
@@ -95,20 +106,30 @@ uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t *data) {
   TxHeader.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
   TxHeader.BitRateSwitch = FDCAN_BRS_OFF;
   TxHeader.FDFormat = FDCAN_CLASSIC_CAN;
-  TxHeader.TxEventFifoControl = FDCAN_NO_TX_EVENTS;
-  TxHeader.MessageMarker = 0;
+  if (bus->latency != nullptr) {
+    TxHeader.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
+    TxHeader.MessageMarker = can_latencyOnQueue(bus->latency, id);
+  } else {
+    TxHeader.TxEventFifoControl = FDCAN_NO_TX_EVENTS;
+    TxHeader.MessageMarker = 0;
+  }
 
-  uint32_t error = HAL_FDCAN_AddMessageToTxFifoQ(canHandleTypeDef, &TxHeader, data);
+  uint32_t error = HAL_FDCAN_AddMessageToTxFifoQ(canHandleTypeDef, &TxHeader, const_cast<uint8_t *>(data));
   if (error != HAL_OK) {
-    if(error & HAL_FDCAN_ERROR_FIFO_FULL) {
+    if (bus->latency != nullptr) {
+      can_latencyOnQueueFailed(bus->latency, (uint8_t) TxHeader.MessageMarker);
+    }
+    if(canHandleTypeDef->ErrorCode & HAL_FDCAN_ERROR_FIFO_FULL) {
+      canHandleTypeDef->ErrorCode &= ~HAL_FDCAN_ERROR_FIFO_FULL;
       FAULT_SET(&faultVector, FAULT_VCU_CAN_BAD_TX);
-    } else if(error & 0xFF) {
+      return CAN_SEND_FIFO_FULL;
+    } else if(canHandleTypeDef->ErrorCode & 0xFF) {
       return canHandleTypeDef->ErrorCode;
     }
   }
 #endif
 #ifdef STM32L431xx
-  static CAN_TxHeaderTypeDef TxHeader;
+  CAN_TxHeaderTypeDef TxHeader = {}; // not static, frames can also be sent from the RX interrupt
   if(id > 0x7FF) {
       TxHeader.IDE = CAN_ID_EXT;
       TxHeader.ExtId = id;
@@ -120,11 +141,13 @@ uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t *data) {
   TxHeader.RTR = CAN_RTR_DATA;
 
   uint32_t TxMailbox;
-  volatile uint32_t error = HAL_CAN_AddTxMessage(canHandleTypeDef, &TxHeader, data, &TxMailbox);
+  volatile uint32_t error = HAL_CAN_AddTxMessage(canHandleTypeDef, &TxHeader, const_cast<uint8_t *>(data), &TxMailbox);
   if (error != HAL_OK) {
-    if(canHandleTypeDef->ErrorCode & 0x200000) { // full probably
+    if(canHandleTypeDef->ErrorCode & HAL_CAN_ERROR_PARAM) { // no free mailbox
+      canHandleTypeDef->ErrorCode &= ~HAL_CAN_ERROR_PARAM;
       HAL_CAN_AbortTxRequest(canHandleTypeDef, 0x7);
       FAULT_SET(&faultVector, FAULT_VCU_CAN_BAD_TX);
+      return CAN_SEND_FIFO_FULL;
     } else {
       return canHandleTypeDef->ErrorCode;
     }
@@ -134,60 +157,331 @@ uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t *data) {
   return 0;
 }
 
+uint32_t can_busGetTxFreeLevel(CanBus *bus) {
+#ifdef H7_SERIES
+  return HAL_FDCAN_GetTxFifoFreeLevel(bus->handle);
+#endif
+#ifdef STM32L431xx
+  return HAL_CAN_GetTxMailboxesFreeLevel(bus->handle);
+#endif
+}
+
+uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t *data) {
+  return can_busSend(&defaultBus, id, dlc, data);
+}
+
+uint32_t can_busSetImmediateBand(CanBus *bus, uint32_t idLow, uint32_t idHigh, uint32_t filter) {
+  if (idLow > idHigh || idHigh > 0x7FF) {
+    return 1;
+  }
+#ifdef H7_SERIES
+  if (filter > 127) { // standard filter elements in the message RAM
+    return 1;
+  }
+#endif
+#ifdef STM32L431xx
+  // bxCAN filters are masks, so the band has to be an aligned power-of-two block of IDs
+  uint32_t size = idHigh - idLow + 1;
+  if ((size & (size - 1)) != 0 || (idLow & (size - 1)) != 0 || filter > 13) {
+    return 1;
+  }
+#endif
+  bus->_immediateLow = idLow;
+  bus->_immediateHigh = idHigh;
+  bus->_immediateFilter = filter;
+  return 0;
+}
 
-void can_init(CAN_HANDLE *handle) {
-  canHandleTypeDef = handle;
+bool can_busIsImmediate(const CanBus *bus, uint32_t id) {
+  return id >= bus->_immediateLow && id <= bus->_immediateHigh;
+}
 
+/**
+ * Route the immediate band to RX FIFO 1 with the filter reserved for it and enable the FIFO 1 interrupt.
+ * Frames the band does not match are left to the application's filters (RX FIFO 0, emptied by can_busPeriodic).
+ * @return HAL status
+ */
+static uint32_t can_configureImmediateBand(CanBus *bus) {
 #ifdef H7_SERIES
-  HAL_FDCAN_Start(canHandleTypeDef);
+  if (bus->_immediateFilter >= bus->handle->Init.StdFiltersNbr || bus->handle->Init.RxFifo1ElmtsNbr == 0) {
+    return HAL_ERROR; // the message RAM has no room for the filter or for frames in RX FIFO 1
+  }
+  FDCAN_FilterTypeDef filter = {};
+  filter.IdType = FDCAN_STANDARD_ID;
+  filter.FilterIndex = bus->_immediateFilter;
+  filter.FilterType = FDCAN_FILTER_RANGE;
+  filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
+  filter.FilterID1 = bus->_immediateLow;
+  filter.FilterID2 = bus->_immediateHigh;
+  uint32_t status = HAL_FDCAN_ConfigFilter(bus->handle, &filter);
+  if (status != HAL_OK) {
+    return status;
+  }
+  return HAL_FDCAN_ActivateNotification(bus->handle, FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
 #endif
 #ifdef STM32L431xx
-  HAL_CAN_Start(canHandleTypeDef);
+  uint32_t mask = ~(bus->_immediateHigh - bus->_immediateLow) & 0x7FF;
+  CAN_FilterTypeDef filter = {};
+  filter.FilterBank = bus->_immediateFilter;
+  filter.FilterMode = CAN_FILTERMODE_IDMASK;
+  filter.FilterScale = CAN_FILTERSCALE_32BIT;
+  filter.FilterIdHigh = bus->_immediateLow << 5;
+  filter.FilterMaskIdHigh = mask << 5;
+  filter.FilterMaskIdLow = 0x0004; // standard IDs only
+  filter.FilterFIFOAssignment = CAN_FILTER_FIFO1;
+  filter.FilterActivation = CAN_FILTER_ENABLE;
+  filter.SlaveStartFilterBank = 14;
+  uint32_t status = HAL_CAN_ConfigFilter(bus->handle, &filter);
+  if (status != HAL_OK) {
+    return status;
+  }
+  return HAL_CAN_ActivateNotification(bus->handle, CAN_IT_RX_FIFO1_MSG_PENDING);
 #endif
 }
 
-void can_addOutbox(uint32_t id, float period, CanOutbox *outbox) {
+uint32_t can_busInit(CanBus *bus, CAN_HANDLE *handle) {
+  bus->handle = handle;
+
+  if (bus->_immediateLow <= bus->_immediateHigh) {
+    uint32_t status = can_configureImmediateBand(bus);
+    if (status != HAL_OK) {
+      return status;
+    }
+  }
+
+#ifdef H7_SERIES
+  return HAL_FDCAN_Start(bus->handle);
+#endif
+#ifdef STM32L431xx
+  return HAL_CAN_Start(bus->handle);
+#endif
+}
+
+uint32_t can_busSetTimestampPeriod(CanBus *bus, float tickSeconds) {
+#ifdef H7_SERIES
+  bus->_timestampReference = HAL_FDCAN_GetTimestampCounter(bus->handle);
+  bus->timestampPeriod = tickSeconds;
+  return 0;
+#else
+  (void) bus;
+  (void) tickSeconds;
+  return 1;
+#endif
+}
+
+void can_busEnableDispatchTiming(CanBus *bus) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#ifdef H7_SERIES
+  DWT->LAR = 0xC5ACCE55; // the Cortex-M7 ignores DWT writes until the lock access register is unlocked
+#endif
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  bus->dispatchStats = CanDispatchStats();
+  bus->_measureDispatch = true;
+}
+
+uint32_t can_init(CAN_HANDLE *handle) {
+  return can_busInit(&defaultBus, handle);
+}
+
+CanBus *can_getDefaultBus() {
+  return &defaultBus;
+}
+
+void can_busAddOutbox(CanBus *bus, uint32_t id, float period, CanOutbox *outbox) {
   outbox->period = period;
-  allOutboxes.insert({id, outbox});
+  bus->outboxes.insert({id, outbox});
 }
 
-void can_addOutboxes(uint32_t idLow, uint32_t idHigh, float period, CanOutbox *outboxes) {
+void can_busAddOutboxes(CanBus *bus, uint32_t idLow, uint32_t idHigh, float period, CanOutbox *outboxes) {
   float staggerInterval = period / ((float)(idHigh - idLow + 1));
   float stagger = 0;
   for (uint32_t i = idLow; i <= idHigh; i++, outboxes++) {
     outboxes->_timer = stagger;
-    can_addOutbox(i, period, outboxes);
+    can_busAddOutbox(bus, i, period, outboxes);
     stagger += staggerInterval;
   }
 }
 
-void can_addInbox(uint32_t id, CanInbox *mailbox, float timeoutLimit) {
+void can_busAddInbox(CanBus *bus, uint32_t id, CanInbox *mailbox, float timeoutLimit) {
   mailbox->timeLimit = timeoutLimit;
-  allInboxes.insert({id, mailbox});
+  bus->inboxes.insert({id, mailbox});
 }
 
-void can_addInboxes(uint32_t idLow, uint32_t idHigh, CanInbox *mailboxes, float timeoutLimit) {
+void can_busAddInboxes(CanBus *bus, uint32_t idLow, uint32_t idHigh, CanInbox *mailboxes, float timeoutLimit) {
   for (uint32_t i = idLow; i <= idHigh; i++) {
-    can_addInbox(i, &mailboxes[i - idLow], timeoutLimit);
+    can_busAddInbox(bus, i, &mailboxes[i - idLow], timeoutLimit);
+  }
+}
+
+void can_addOutbox(uint32_t id, float period, CanOutbox *outbox) {
+  can_busAddOutbox(&defaultBus, id, period, outbox);
+}
+
+void can_addOutboxes(uint32_t idLow, uint32_t idHigh, float period, CanOutbox *outboxes) {
+  can_busAddOutboxes(&defaultBus, idLow, idHigh, period, outboxes);
+}
+
+void can_addInbox(uint32_t id, CanInbox *mailbox, float timeoutLimit) {
+  can_busAddInbox(&defaultBus, id, mailbox, timeoutLimit);
+}
+
+void can_addInboxes(uint32_t idLow, uint32_t idHigh, CanInbox *mailboxes, float timeoutLimit) {
+  can_busAddInboxes(&defaultBus, idLow, idHigh, mailboxes, timeoutLimit);
+}
+
+uint32_t can_setInboxHandler(CanInbox *inbox, CanHandler handler, void *context) {
+  uint8_t slot = inbox->_handler;
+  if (handler == nullptr) {
+    // unhook the inbox before the slot can be taken by another one
+    __atomic_store_n(&inbox->_handler, 0, __ATOMIC_RELEASE);
+    if (slot != 0) {
+      __atomic_store_n(&handlers[slot - 1].handler, nullptr, __ATOMIC_RELEASE);
+    }
+    return 0;
+  }
+
+  for (uint8_t i = 0; slot == 0 && i < CAN_MAX_HANDLERS; i++) {
+    if (handlers[i].handler == nullptr) {
+      slot = i + 1;
+    }
+  }
+  if (slot == 0) {
+    return 1;
+  }
+  // the RX interrupt must never see the new handler with the old context
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  handlers[slot - 1] = {handler, context};
+  inbox->_handler = slot;
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+// rxTime is copied as two words, 64-bit atomics are not lock-free on Cortex-M
+typedef uint32_t __attribute__((__may_alias__)) CanTimeWord;
+
+/**
+ * Seqlock writer. The sequence is odd while the frame is being replaced, and the bytes are stored
+ * individually so that a concurrent reader is never a data race, only a retry.
+ */
+static void can_storeFrame(CanInbox *inbox, uint8_t dlc, const uint8_t *data, double rxTime) {
+  uint32_t sequence = inbox->_sequence;
+  __atomic_store_n(&inbox->_sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  for (uint8_t i = 0; i < dlc; i++) {
+    __atomic_store_n(&inbox->data[i], data[i], __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&inbox->dlc, dlc, __ATOMIC_RELAXED);
+  const CanTimeWord *time = reinterpret_cast<const CanTimeWord *>(&rxTime);
+  CanTimeWord *inboxTime = reinterpret_cast<CanTimeWord *>(&inbox->rxTime);
+  __atomic_store_n(&inboxTime[0], time[0], __ATOMIC_RELAXED);
+  __atomic_store_n(&inboxTime[1], time[1], __ATOMIC_RELAXED);
+  __atomic_store_n(&inbox->_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void can_readInbox(const CanInbox *inbox, CanFrame *frame) {
+  uint32_t before, after;
+  do {
+    before = __atomic_load_n(&inbox->_sequence, __ATOMIC_ACQUIRE);
+    for (uint8_t i = 0; i < 8; i++) {
+      frame->data[i] = __atomic_load_n(&inbox->data[i], __ATOMIC_RELAXED);
+    }
+    frame->dlc = __atomic_load_n(&inbox->dlc, __ATOMIC_RELAXED);
+    const CanTimeWord *inboxTime = reinterpret_cast<const CanTimeWord *>(&inbox->rxTime);
+    CanTimeWord *time = reinterpret_cast<CanTimeWord *>(&frame->rxTime);
+    time[0] = __atomic_load_n(&inboxTime[0], __ATOMIC_RELAXED);
+    time[1] = __atomic_load_n(&inboxTime[1], __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&inbox->_sequence, __ATOMIC_RELAXED);
+  } while ((before & 1) || before != after);
+}
+
+uint32_t can_getInboxSequence(const CanInbox *inbox) {
+  return __atomic_load_n(&inbox->_sequence, __ATOMIC_ACQUIRE) >> 1;
+}
+
+/**
+ * Add one dispatch time to the bus statistics. Both RX paths record, so the update is kept from being
+ * interrupted halfway.
+ */
+static void can_recordDispatch(CanBus *bus, uint32_t cycles) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  bus->dispatchStats.count++;
+  bus->dispatchStats.lastCycles = cycles;
+  bus->dispatchStats.totalCycles += cycles;
+  if (cycles > bus->dispatchStats.maxCycles) {
+    bus->dispatchStats.maxCycles = cycles;
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @return Bus time at which a frame with the given hardware RX timestamp was received
+ */
+static double can_frameTime(const CanBus *bus, uint32_t timestamp) {
+#ifdef H7_SERIES
+  if (bus->timestampPeriod != 0) {
+    // signed, so frames the interrupt receives after the reference was sampled land after bus->time
+    int16_t ticks = (int16_t) (uint16_t) (timestamp - bus->_timestampReference);
+    return bus->time + (double) ((float) ticks * bus->timestampPeriod);
+  }
+#endif
+  (void) timestamp;
+  return bus->time;
+}
+
+/**
+ * Hand one received frame to the latency monitor and gateway (if any) and store it in its inbox (if any).
+ * The data pointer refers to the buffer the frame was read into from the hardware FIFO.
+ * Age and timeout of the inbox are left to can_sendAll, which sees the new frame by its sequence.
+ * @param timestamp Hardware receive timestamp of the frame, 0 if unavailable
+ * @param fromInterrupt Whether this runs in the RX FIFO 1 interrupt, where the gateway and latency monitor
+ * (main loop state) are not touched; no route or measured response can be in the immediate band
+ */
+static void can_dispatch(CanBus *bus, uint32_t id, uint8_t dlc, const uint8_t *data, uint32_t timestamp,
+                         bool fromInterrupt) {
+  uint32_t start = bus->_measureDispatch ? DWT->CYCCNT : 0;
+  if (bus->latency != nullptr && !fromInterrupt) {
+    can_latencyOnReceive(bus->latency, id, timestamp);
+  }
+  if (bus->gateway != nullptr && !fromInterrupt) {
+    can_gatewayForward(bus->gateway, id, dlc, data, timestamp);
+  }
+  CanInbox *this_mailbox = can_getInbox(bus, id);
+  if (this_mailbox != nullptr) {
+    double rxTime = can_frameTime(bus, timestamp);
+    can_storeFrame(this_mailbox, dlc, data, rxTime);
+    __atomic_store_n(&this_mailbox->isRecent, true, __ATOMIC_RELAXED);
+    if (this_mailbox->_history != nullptr) {
+      can_historyPush(this_mailbox->_history, dlc, data, rxTime);
+    }
+    CanSnapshotBase *snapshot = __atomic_load_n(&this_mailbox->_snapshot, __ATOMIC_ACQUIRE);
+    if (snapshot != nullptr) {
+      can_snapshotMarkDirty(snapshot, this_mailbox->_snapshotGroup);
+    }
+    uint8_t slot = __atomic_load_n(&this_mailbox->_handler, __ATOMIC_ACQUIRE);
+    if (slot != 0) {
+      const CanHandlerEntry &entry = handlers[slot - 1];
+      CanHandler handler = __atomic_load_n(&entry.handler, __ATOMIC_RELAXED);
+      if (handler != nullptr) {
+        handler(this_mailbox, entry.context);
+      }
+    }
+  }
+  if (bus->_measureDispatch) {
+    can_recordDispatch(bus, DWT->CYCCNT - start);
   }
 }
 
-static uint32_t can_processRxFifo() {
+static uint32_t can_processRxFifo(CanBus *bus) {
+  CAN_HANDLE *canHandleTypeDef = bus->handle;
 #ifdef H7_SERIES
   static FDCAN_RxHeaderTypeDef RxHeader;
   static uint8_t RxData[8];
 
   while (HAL_FDCAN_GetRxMessage(canHandleTypeDef, FDCAN_RX_FIFO0, &RxHeader, RxData) == HAL_OK) {
-    uint32_t id = RxHeader.Identifier;
-    uint8_t dlc = dlc_to_num(RxHeader.DataLength);
-    CanInbox *this_mailbox = can_getInbox(id);
-    if (this_mailbox != nullptr) {
-      copy(RxData, RxData + dlc, this_mailbox->data);
-      this_mailbox->isRecent = true;
-      this_mailbox->dlc = dlc;
-      this_mailbox->ageSinceRx = 0;
-      this_mailbox->isTimeout = false;
-    }
+    can_dispatch(bus, RxHeader.Identifier, dlc_to_num(RxHeader.DataLength), RxData, RxHeader.RxTimestamp, false);
   }
   // If error code is something other than the fifo being empty or full, return error
   if ((canHandleTypeDef->ErrorCode & 0xFF) != HAL_FDCAN_ERROR_NONE) {
@@ -201,15 +495,7 @@ static uint32_t can_processRxFifo() {
     while(HAL_CAN_GetRxFifoFillLevel(canHandleTypeDef, CAN_RX_FIFO0)) {
         if(HAL_CAN_GetRxMessage(canHandleTypeDef, CAN_RX_FIFO0, &RxHeader, RxData) == HAL_OK) {
             uint32_t id = (RxHeader.IDE == CAN_ID_EXT) ? RxHeader.ExtId : RxHeader.StdId;
-            uint32_t dlc = RxHeader.DLC;
-            CanInbox *this_mailbox = can_getInbox(id);
-            if (this_mailbox != nullptr) {
-                copy(RxData, RxData + dlc, this_mailbox->data);
-                this_mailbox->isRecent = true;
-                this_mailbox->dlc = dlc;
-                this_mailbox->ageSinceRx = 0;
-                this_mailbox->isTimeout = false;
-            }
+            can_dispatch(bus, id, RxHeader.DLC, RxData, RxHeader.Timestamp, false);
         } else {
             return canHandleTypeDef->ErrorCode;
         }
@@ -222,38 +508,90 @@ static uint32_t can_processRxFifo() {
   return HAL_OK;
 }
 
-static uint32_t can_sendAll(float deltaTime) {
-  for(const auto & [ id, outbox ] : allOutboxes) {
+void can_busHandleRxInterrupt(CanBus *bus) {
+#ifdef H7_SERIES
+  FDCAN_RxHeaderTypeDef RxHeader;
+  uint8_t RxData[8];
+  while (HAL_FDCAN_GetRxMessage(bus->handle, FDCAN_RX_FIFO1, &RxHeader, RxData) == HAL_OK) {
+    can_dispatch(bus, RxHeader.Identifier, dlc_to_num(RxHeader.DataLength), RxData, RxHeader.RxTimestamp, true);
+  }
+#endif
+#ifdef STM32L431xx
+  CAN_RxHeaderTypeDef RxHeader;
+  uint8_t RxData[8];
+  while (HAL_CAN_GetRxFifoFillLevel(bus->handle, CAN_RX_FIFO1)) {
+    if (HAL_CAN_GetRxMessage(bus->handle, CAN_RX_FIFO1, &RxHeader, RxData) != HAL_OK) {
+      FAULT_SET(&faultVector, FAULT_VCU_CAN_BAD_RX);
+      return;
+    }
+    uint32_t id = (RxHeader.IDE == CAN_ID_EXT) ? RxHeader.ExtId : RxHeader.StdId;
+    can_dispatch(bus, id, RxHeader.DLC, RxData, RxHeader.Timestamp, true);
+  }
+#endif
+}
+
+static uint32_t can_sendAll(CanBus *bus, float deltaTime) {
+  for(const auto & [ id, outbox ] : bus->outboxes) {
     outbox->_timer += deltaTime;
     if(outbox->_timer >= outbox->period) {
       outbox->_timer = fmod(outbox->_timer, outbox->period);
-      uint32_t error = can_send(id, outbox->dlc, outbox->data);
-      if(error != HAL_OK) {
+      uint32_t error = can_busSend(bus, id, outbox->dlc, outbox->data);
+      if(error != HAL_OK && error != CAN_SEND_FIFO_FULL) { // a full FIFO is already reported as a fault
         return error;
       }
     }
   }
-  for(const auto & [ id, inbox ] : allInboxes) {
+  for(const auto & [ id, inbox ] : bus->inboxes) {
+    // frames from the RX interrupt only move the sequence, so age and timeout are owned by this loop
+    uint32_t sequence = __atomic_load_n(&inbox->_sequence, __ATOMIC_ACQUIRE);
+    if(sequence != inbox->_agedSequence) {
+      inbox->_agedSequence = sequence;
+      inbox->ageSinceRx = 0;
+      inbox->isTimeout = false;
+    }
     inbox->ageSinceRx += deltaTime;
     if(inbox->timeLimit != 0 &&
       inbox->timeLimit < inbox->ageSinceRx) { // Checks if the age of the inbox is greater than the timeout and that timeout exists
       inbox->isTimeout = true;
-      inbox->isRecent = false;
+      __atomic_store_n(&inbox->isRecent, false, __ATOMIC_RELAXED);
+      if(__atomic_load_n(&inbox->_sequence, __ATOMIC_ACQUIRE) != sequence) {
+        // a frame arrived in between: it is recent, and the next call restarts its age
+        __atomic_store_n(&inbox->isRecent, true, __ATOMIC_RELAXED);
+      }
     }
   }
   return HAL_OK;
 }
 
-uint32_t can_periodic(float deltaTime) {
-  uint32_t error = can_processRxFifo();
+uint32_t can_busPeriodic(CanBus *bus, float deltaTime) {
+  // the RX interrupt converts timestamps with time and the reference, so it must not see one without the other
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  bus->time += deltaTime;
+#ifdef H7_SERIES
+  if (bus->timestampPeriod != 0) {
+    bus->_timestampReference = HAL_FDCAN_GetTimestampCounter(bus->handle);
+  }
+#endif
+  __set_PRIMASK(primask);
+
+  if (bus->latency != nullptr) {
+    can_latencyProcessTxEvents(bus->latency);
+  }
+
+  uint32_t error = can_processRxFifo(bus);
   if (error != HAL_OK) {
     return error; // 0x300
   }
 
-  error = can_sendAll(deltaTime);
+  error = can_sendAll(bus, deltaTime);
   if (error != HAL_OK) {
     return error;
   }
 
   return HAL_OK;
 }
+
+uint32_t can_periodic(float deltaTime) {
+  return can_busPeriodic(&defaultBus, deltaTime);
+}
@@ -2,6 +2,8 @@
 #define LONGHORN_LIBRARY_2024_CAN_H
 
 #include <stdint.h>
+#include <string.h>
+#include <unordered_map>
 #include "angel_can_ids.h"
 
 #ifdef STM32H7A3xxQ
@@ -19,15 +21,45 @@
 #define CAN_HANDLE CAN_HandleTypeDef
 #endif
 
+struct CanHistoryRing;
+struct CanSnapshotBase;
+
 typedef struct CanInbox {
   bool isRecent = false;
   uint8_t dlc = 0;
   uint8_t data[8] = {};
-  float ageSinceRx = 0;
+  float ageSinceRx = 0; // updated by can_busPeriodic, like isTimeout
   float timeLimit = 0;
   bool isTimeout = false;
+  double rxTime = 0; // bus time in seconds when the frame was received (see can_busSetTimestampPeriod)
+  uint32_t _sequence = 0; // odd while the RX path is writing dlc, data and rxTime
+  uint32_t _agedSequence = 0; // _sequence when can_busPeriodic last reset ageSinceRx
+  uint8_t _handler = 0; // index + 1 into the handler table, 0 if none
+  CanHistoryRing *_history = nullptr;
+  CanSnapshotBase *_snapshot = nullptr; // snapshot reading this inbox, told which of its groups got a frame
+  uint16_t _snapshotGroup = 0;
 } CanInbox;
 
+#define CAN_SEND_FIFO_FULL 2 // can_busSend: the Tx FIFO (mailboxes on bxCAN) had no room, the frame was dropped
+
+#ifndef CAN_MAX_HANDLERS
+#define CAN_MAX_HANDLERS 64 // at most 255
+#endif
+
+/**
+ * Called from the RX path right after a frame has been stored in the inbox.
+ */
+typedef void (*CanHandler)(CanInbox *inbox, void *context);
+
+/**
+ * Consistent copy of the frame held by an inbox.
+ */
+typedef struct CanFrame {
+  uint8_t dlc = 0;
+  uint8_t data[8] = {};
+  double rxTime = 0;
+} CanFrame;
+
 typedef struct CanOutbox {
   bool isRecent = false; // obsolete
   uint8_t dlc = 0;
@@ -36,7 +68,104 @@ typedef struct CanOutbox {
   float _timer = 0;
 } CanOutbox;
 
-void can_init(CAN_HANDLE *handle);
+struct CanGateway;
+struct CanLatencyMonitor;
+
+/**
+ * Cost of handling received frames (inbox copy, gateway and handler), in CPU cycles.
+ */
+typedef struct CanDispatchStats {
+  uint32_t count = 0;
+  uint32_t lastCycles = 0;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+} CanDispatchStats;
+
+/**
+ * One CAN peripheral together with its own inbox and outbox registries.\n
+ * Boards with several controllers (e.g. FDCAN1 and FDCAN2 on the H7) declare one CanBus per peripheral.
+ * The can_* functions without a bus argument operate on the default bus.
+ */
+typedef struct CanBus {
+  CAN_HANDLE *handle = nullptr;
+  std::unordered_map<uint32_t, CanInbox *> inboxes;
+  std::unordered_map<uint32_t, CanOutbox *> outboxes;
+  CanGateway *gateway = nullptr;
+  CanLatencyMonitor *latency = nullptr;
+  double time = 0; // seconds, advanced by can_busPeriodic (a float stops counting 1 ms steps after a few hours)
+  float timestampPeriod = 0; // seconds per hardware timestamp tick, 0 to stamp frames with time
+  uint16_t _timestampReference = 0; // timestamp counter when time was last advanced
+  CanDispatchStats dispatchStats;
+  bool _measureDispatch = false;
+  uint32_t _immediateLow = 1; // empty band
+  uint32_t _immediateHigh = 0;
+  uint32_t _immediateFilter = 0;
+} CanBus;
+
+/**
+ * Same as can_busInit, on the default bus.
+ */
+uint32_t can_init(CAN_HANDLE *handle);
+
+/**
+ * Bind a bus to its peripheral and start it.
+ * @param bus Bus to initialize
+ * @param handle HAL handle of the CAN peripheral, with its acceptance filters already configured
+ * @return 0 if successful, otherwise the HAL status of the step that failed (HAL_ERROR if the message RAM
+ * has no room for the immediate band's filter or RX FIFO 1)
+ */
+uint32_t can_busInit(CanBus *bus, CAN_HANDLE *handle);
+
+/**
+ * @return The bus used by the can_* functions that take no bus argument
+ */
+CanBus *can_getDefaultBus();
+
+/**
+ * Handle standard IDs in the given range from the RX interrupt instead of from can_busPeriodic.\n
+ * Must be called before can_busInit, which routes the range to RX FIFO 1 with the given filter and enables the
+ * FIFO 1 interrupt. Only that filter is written: the global filter and the application's own filters are
+ * left alone, so pick a slot the application does not use, matched before any of its filters that accept the
+ * same IDs into FIFO 0 (a lower standard filter index on the FDCAN, a lower filter bank on bxCAN).
+ * The FDCAN message RAM needs the slot within StdFiltersNbr and RxFifo1ElmtsNbr > 0; on the L431 the range
+ * must be an aligned power-of-two block.
+ * Call can_busHandleRxInterrupt from HAL_FDCAN_RxFifo1Callback / HAL_CAN_RxFifo1MsgPendingCallback.
+ * Inbox handlers for these IDs then run within microseconds of reception, in interrupt context, so they must
+ * not call can_busSend (the HAL Tx FIFO is not reentrant) and should only store or flag data for the main loop.
+ * Frames in the band are not forwarded by a gateway or measured by a latency monitor, and gateway routes,
+ * latency responses, ISO-TP channels and DAQ commands are refused for IDs in the band: set the band first.
+ * @param filter Standard filter index (FDCAN, 0-127) or filter bank (bxCAN, 0-13) given to the band
+ * @return 0 if successful, 1 if the range or filter is invalid
+ */
+uint32_t can_busSetImmediateBand(CanBus *bus, uint32_t idLow, uint32_t idHigh, uint32_t filter);
+
+/**
+ * Empty RX FIFO 1 of the bus, storing frames and running inbox handlers right away.
+ * Only call this from the RX FIFO 1 interrupt callback.
+ */
+void can_busHandleRxInterrupt(CanBus *bus);
+
+/**
+ * @return true if frames with this ID are handled from the RX interrupt (see can_busSetImmediateBand)
+ */
+bool can_busIsImmediate(const CanBus *bus, uint32_t id);
+
+/**
+ * Stamp received frames (inbox rxTime and history) with their hardware RX timestamp, converted to bus time,
+ * instead of the bus time of the can_busPeriodic call that emptied the FIFO.\n
+ * The application configures and enables the FDCAN timestamp counter (HAL_FDCAN_ConfigTimestampCounter,
+ * HAL_FDCAN_EnableTimestampCounter). can_busPeriodic samples the counter along with the bus time, so it must
+ * run at least every 32768 ticks.
+ * @param tickSeconds Duration of one timestamp counter tick, 0 to go back to the bus time
+ * @return 0 if successful, 1 if the MCU has no readable timestamp counter (bxCAN)
+ */
+uint32_t can_busSetTimestampPeriod(CanBus *bus, float tickSeconds);
+
+/**
+ * Start measuring how many CPU cycles each received frame takes to dispatch, using the DWT cycle counter.
+ * Results are in bus->dispatchStats.
+ */
+void can_busEnableDispatchTiming(CanBus *bus);
 
 /**
  * Add a CAN outbox to be sent periodically.\n
@@ -75,21 +204,82 @@ void can_addInbox(uint32_t id, CanInbox *inbox, float timeoutLimit = 0);
  */
 void can_addInboxes(uint32_t idLow, uint32_t idHigh, CanInbox *inboxes, float timeoutLimit = 0);
 
+/**
+ * Same as can_addOutbox, but on the given bus.
+ */
+void can_busAddOutbox(CanBus *bus, uint32_t id, float period, CanOutbox *outbox);
+
+/**
+ * Same as can_addOutboxes, but on the given bus.
+ */
+void can_busAddOutboxes(CanBus *bus, uint32_t idLow, uint32_t idHigh, float period, CanOutbox *outboxes);
+
+/**
+ * Same as can_addInbox, but on the given bus.
+ */
+void can_busAddInbox(CanBus *bus, uint32_t id, CanInbox *inbox, float timeoutLimit = 0);
+
+/**
+ * Same as can_addInboxes, but on the given bus.
+ */
+void can_busAddInboxes(CanBus *bus, uint32_t idLow, uint32_t idHigh, CanInbox *inboxes, float timeoutLimit = 0);
+
+/**
+ * Run the given function every time the inbox receives a frame, from inside can_periodic,
+ * or from the RX interrupt if the ID is in the bus's immediate band (see can_busSetImmediateBand).\n
+ * Handlers live in a static table of CAN_MAX_HANDLERS entries, so no heap is used.
+ * @param inbox Inbox that was added with can_addInbox
+ * @param handler Function to call, nullptr to remove the handler
+ * @param context Passed back to the handler
+ * @return 0 if successful, 1 if the handler table is full
+ */
+uint32_t can_setInboxHandler(CanInbox *inbox, CanHandler handler, void *context);
+
 /**
  * Update the corresponding mailboxes, emptying the RxFifo.
  */
 uint32_t can_periodic(float deltaTime);
 
+/**
+ * Same as can_periodic, but on the given bus. Call once per loop for every bus in use.
+ */
+uint32_t can_busPeriodic(CanBus *bus, float deltaTime);
+
 /**
  * Attempts to send a CAN packet. There are no restrictions at this point, so only use if necessary.
  * @param id ID of the CAN packet
  * @param dlc Length of the CAN packet
  * @param data Data of the CAN packet
  * @param delta Time in milliseconds between each packet
- * @return 0 if successful, 1 if error, 2 if unsuccessful send
+ * @return 0 if successful, CAN_SEND_FIFO_FULL (2) if the Tx FIFO was full, otherwise the HAL error code
  */
 uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t data[8]);
 
+/**
+ * Same as can_send, but on the given bus.
+ */
+uint32_t can_busSend(CanBus *bus, uint32_t id, uint8_t dlc, const uint8_t *data);
+
+/**
+ * @return Number of frames that can be queued on the bus right now without overflowing the TX FIFO / mailboxes
+ */
+uint32_t can_busGetTxFreeLevel(CanBus *bus);
+
+/**
+ * Copy dlc, data and rxTime out of an inbox without tearing, even if the frame is overwritten
+ * from an interrupt or another task while it is being read.\n
+ * The RX path is the only writer and never waits; a reader that overlaps a write retries its copy.
+ * Do not call this from a context that can preempt the RX path of the same bus.
+ * @param inbox Inbox to read
+ * @param frame Where the copy is stored
+ */
+void can_readInbox(const CanInbox *inbox, CanFrame *frame);
+
+/**
+ * @return Counter that advances every time the inbox receives a frame
+ */
+uint32_t can_getInboxSequence(const CanInbox *inbox);
+
 /**
  * Read a integral value from the packets, based on the given type
  * @param Inbox Inbox of the CAN packet, which stores the data and dlc
@@ -130,4 +320,16 @@ uint32_t can_send(uint32_t id, uint8_t dlc, uint8_t data[8]);
 #define can_writeFloat(T, outbox, start_byte, value, precision) \
   (*(reinterpret_cast<T *>((outbox)->data + (start_byte))) = static_cast<T>((value) / (precision)))
 
+/**
+ * Same conversion as can_readFloat, for a value starting at data. Safe for unaligned data.
+ * @param data First byte of the value
+ * @param precision The amount of decimal places to read
+ */
+template<typename T>
+float can_decodeSignal(const uint8_t *data, float precision) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return static_cast<float>(value * precision);
+}
+
 #endif //LONGHORN_LIBRARY_2024_CAN_H
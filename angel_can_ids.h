@@ -33,11 +33,16 @@
  * - 0x370: HVC->VCU Cell Temperatures - 3 for low priority, 7 for HVC, 0 for whatever is available
  */
 
-//Parameters to set to boards (unused currently)
-#define VCU_HVC_PARAMS 0x010
-#define VCU_PDU_PARAMS 0x011
-#define VCU_UNS_PARAMS 0x012
-#define VCU_DSH_PARAMS 0x013
+//Parameter blocks and logs exchanged with boards over ISO-TP (see isotp.h), one ID per direction
+//These carry multi-kB transfers, so they sit at the bottom of the low priority range and never hold off control msgs
+#define VCU_HVC_PARAMS 0x71C
+#define VCU_PDU_PARAMS 0x71D
+#define VCU_UNS_PARAMS 0x71E
+#define VCU_DSH_PARAMS 0x71F
+#define HVC_VCU_PARAMS 0x72F
+#define PDU_VCU_PARAMS 0x73F
+#define UNS_VCU_PARAMS 0x74F
+#define DSH_VCU_PARAMS 0x75F
 
 /**
  * The following are the CAN IDs pre-defined by CM200DZ, the inverter we use.
@@ -74,6 +79,9 @@
  * These are specifically telemetry messages from the VCU.
  * [011 0001 ****] OR [100 0001 ****]
  */
+#define DAQ_VCU_COMMAND 0x41D //Configures DAQ measurement lists (from the host tool, see daq.h)
+#define VCU_DAQ_RESPONSE 0x41E //Acknowledges DAQ commands
+#define VCU_DAQ_DATA 0x41F //Sampled DAQ measurement data
 
 /**
  * The following are the CAN IDs generated by the HVC.
@@ -141,9 +149,9 @@
 #define UNSBL_VCU_IMU 0x34D //Stores acceleration of BL wheel
 #define UNSBL_DSH_FAULT_MSG_ 0x34F //Stores fault info of BL unsprung board
 
-#define GPS_FRAME_1 0x600   // lat, long, speed, heading
-#define GPS_FRAME_2 0x601   // hour, minute, seconds, year
-#define GPS_FRAME_3 0x602   // month, day, millis
+#define GPS_FRAME_1 0x600   // lat, long (int32, 1e-7 deg each), see gps.h
+#define GPS_FRAME_2 0x601   // speed (0.01 m/s), heading (0.01 deg), hour, minute, seconds, year
+#define GPS_FRAME_3 0x602   // month, day, millis, fix quality, satellites, altitude (0.1 m)
 // #define GPS_LATITUDE    0x600 // 6 is free, HVC isn't using it
 // #define GPS_LONGITUDE   0x601
 // #define GPS_SPEED       0x602
@@ -0,0 +1,663 @@
+#include "host_hal.h"
+#include "angel_can.h"
+#include "can_planner.h"
+#include "can_snapshot.h"
+#include "delta_codec.h"
+#include "faults.h"
+#include "gps.h"
+#include "imu.h"
+#include "isotp.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/**
+ * Host benchmarks for the library hot paths, run against the stand-in HAL in host/.
+ *
+ *   longhorn_bench [--quick] [--json FILE] [--baseline FILE] [--tolerance FRACTION] [--noise-floor NS]
+ *
+ * Timings are the median of several runs in nanoseconds per operation, each run repeating the operation until it
+ * has taken at least BENCH_MIN_RUN_MS; metrics are deterministic properties of the encodings and schedules
+ * (frames per tick, compression, line efficiency). Results are printed as JSON and optionally written to FILE.
+ * With --baseline, any timing that got slower by more than the tolerance (default 0.25) and by more than the
+ * noise floor (default 5 ns per operation), or metric that got worse by more than the tolerance, is reported
+ * and the exit code is 1. A failed sanity check exits with 2.
+ */
+
+#define BENCH_MAX_RESULTS 32
+#define BENCH_TICK 0.001f
+#define BENCH_BITRATE 1000000
+#define BENCH_MIN_RUN_MS 20 // shorter runs are dominated by timer resolution and scheduling
+#define BENCH_MAX_REPEATS 15
+
+typedef struct BenchResult {
+  const char *name;
+  const char *unit; // what one operation is
+  double nsPerOp;
+  uint64_t ops;
+} BenchResult;
+
+typedef struct BenchMetric {
+  const char *name;
+  double value;
+  bool lowerIsBetter;
+} BenchMetric;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static uint32_t resultCount = 0;
+static BenchMetric metrics[BENCH_MAX_RESULTS];
+static uint32_t metricCount = 0;
+static uint32_t repeats = 9; // at most BENCH_MAX_REPEATS
+static uint32_t scale = 1; // divides the operation counts in quick mode
+static double minRunNs = BENCH_MIN_RUN_MS * 1e6;
+static uint32_t sanityFailures = 0;
+
+static volatile float floatSink;
+static volatile uint32_t intSink;
+
+static void bench_check(bool condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "sanity check failed: %s\n", what);
+    sanityFailures++;
+  }
+}
+
+/**
+ * @return Nanoseconds body took to perform ops operations
+ */
+template<typename F>
+static double bench_time(uint64_t ops, F &body) {
+  auto start = std::chrono::steady_clock::now();
+  body(ops);
+  auto end = std::chrono::steady_clock::now();
+  return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/**
+ * Time body, which performs ops operations, and record the median of the runs. The operation count is raised
+ * until one run takes at least minRunNs.
+ */
+template<typename F>
+static void bench_run(const char *name, const char *unit, uint64_t ops, F body) {
+  ops = (ops / scale > 0) ? ops / scale : 1;
+  double ns = bench_time(ops, body); // also warms up the caches
+  while (ns < minRunNs) {
+    double factor = (ns > 0) ? minRunNs / ns * 1.2 : 10;
+    ops = (uint64_t) ((double) ops * ((factor < 10) ? factor : 10)) + 1;
+    ns = bench_time(ops, body);
+  }
+
+  double runs[BENCH_MAX_REPEATS];
+  for (uint32_t i = 0; i < repeats; i++) {
+    double perOp = bench_time(ops, body) / (double) ops;
+    uint32_t j = i;
+    for (; j > 0 && runs[j - 1] > perOp; j--) { // insertion sort, there are only a few
+      runs[j] = runs[j - 1];
+    }
+    runs[j] = perOp;
+  }
+  double median = (repeats % 2 == 1) ? runs[repeats / 2] : (runs[repeats / 2 - 1] + runs[repeats / 2]) / 2;
+  if (resultCount < BENCH_MAX_RESULTS) {
+    results[resultCount++] = {name, unit, median, ops};
+  }
+}
+
+static void bench_metric(const char *name, double value, bool lowerIsBetter) {
+  if (metricCount < BENCH_MAX_RESULTS) {
+    metrics[metricCount++] = {name, value, lowerIsBetter};
+  }
+}
+
+/* CAN RX / TX ========================================================== */
+
+static HostCanHandle rxHandle;
+static CanBus rxBus;
+static CanInbox cellVoltageInboxes[HVC_VCU_CELL_VOLTAGES_END - HVC_VCU_CELL_VOLTAGES_START + 1];
+static CanInbox cellTempInboxes[HVC_VCU_CELL_TEMPS_END - HVC_VCU_CELL_TEMPS_START + 1];
+static CanInbox statusInboxes[8];
+static const uint32_t statusIds[8] = {HVC_VCU_AMS_IMD, HVC_VCU_PACK_STATUS, HVC_VCU_IMU_ACCEL, HVC_VCU_IMU_GYRO,
+                                      INV_CURRENT, INV_VOLTAGE, PDU_VCU_LVBAT, HVC_VCU_CONTACTOR_STATUS};
+
+static void bench_canRx() {
+  host_canReset(&rxHandle);
+  can_busInit(&rxBus, &rxHandle);
+  can_busAddInboxes(&rxBus, HVC_VCU_CELL_VOLTAGES_START, HVC_VCU_CELL_VOLTAGES_END, cellVoltageInboxes, 1.0f);
+  can_busAddInboxes(&rxBus, HVC_VCU_CELL_TEMPS_START, HVC_VCU_CELL_TEMPS_END, cellTempInboxes, 1.0f);
+  for (uint32_t i = 0; i < 8; i++) {
+    can_busAddInbox(&rxBus, statusIds[i], &statusInboxes[i], 0.1f);
+  }
+
+  // a received burst: every status frame plus a rotating window of cell frames, 32 frames per FIFO drain
+  static uint32_t ids[32];
+  for (uint32_t i = 0; i < 32; i++) {
+    ids[i] = (i < 8) ? statusIds[i] : HVC_VCU_CELL_VOLTAGES_START + (i * 7) % 35;
+  }
+  const uint8_t payload[8] = {0x10, 0x0E, 0x20, 0x0E, 0x30, 0x0E, 0x40, 0x0E};
+
+  bench_run("can_rx_dispatch", "frame", 500000, [&](uint64_t ops) {
+    for (uint64_t done = 0; done < ops; done += 32) {
+      for (uint32_t id : ids) {
+        host_canInject(&rxHandle, HOST_CAN_RX_FIFO0, id, 8, payload);
+      }
+      can_busPeriodic(&rxBus, 0);
+    }
+  });
+  bench_check(statusInboxes[1].isRecent && cellVoltageInboxes[0].data[1] == 0x0E, "inboxes received the burst");
+
+  can_busEnableDispatchTiming(&rxBus);
+  for (uint32_t id : ids) {
+    host_canInject(&rxHandle, HOST_CAN_RX_FIFO0, id, 8, payload);
+  }
+  can_busPeriodic(&rxBus, 0);
+  bench_check(rxBus.dispatchStats.count == 32, "dispatch timing counted every frame");
+}
+
+static HostCanHandle txHandle;
+static CanBus txBus;
+static CanOutbox txOutboxes[70];
+
+static void bench_canTx() {
+  host_canReset(&txHandle);
+  can_busInit(&txBus, &txHandle);
+  // VCU-sized outbox set, all due every tick so each call sends 70 frames
+  can_busAddOutboxes(&txBus, 0x370, 0x370 + 34, BENCH_TICK, txOutboxes);
+  can_busAddOutboxes(&txBus, 0x470, 0x470 + 22, BENCH_TICK, txOutboxes + 35);
+  can_busAddOutboxes(&txBus, 0x110, 0x110 + 11, BENCH_TICK, txOutboxes + 58);
+  for (CanOutbox &outbox : txOutboxes) {
+    outbox.dlc = 8;
+  }
+
+  uint32_t before = host_canGetTxCount(&txHandle);
+  bench_run("can_send_all", "frame", 1000000, [&](uint64_t ops) {
+    for (uint64_t done = 0; done < ops; done += 70) {
+      can_busPeriodic(&txBus, BENCH_TICK);
+    }
+  });
+  bench_check(host_canGetTxCount(&txHandle) - before >= 70, "outboxes were sent");
+}
+
+static void bench_canPlanner() {
+  static HostCanHandle handle;
+  static CanBus bus;
+  static CanOutbox cells[58];
+  static CanOutbox fast[4];
+  static CanOutbox slow[4];
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  can_busAddOutboxes(&bus, HVC_VCU_CELL_VOLTAGES_START, HVC_VCU_CELL_VOLTAGES_END, 0.1f, cells);
+  can_busAddOutboxes(&bus, HVC_VCU_CELL_TEMPS_START, HVC_VCU_CELL_TEMPS_END, 0.1f, cells + 35);
+  can_busAddOutboxes(&bus, HVC_VCU_PACK_STATUS, HVC_VCU_CCS_INFO, 0.01f, fast);
+  can_busAddOutbox(&bus, HVC_VCU_AMS_IMD, 0.05f, &slow[0]);
+  can_busAddOutbox(&bus, HVC_VCU_CONTACTOR_STATUS, 0.05f, &slow[1]);
+  can_busAddOutbox(&bus, HVC_VCU_FAN_RPM, 0.1f, &slow[2]);
+  can_busAddOutbox(&bus, HVC_DSH_FAULT_MSG, 0.1f, &slow[3]);
+
+  CanPlanReport unplanned;
+  CanPlanReport planned;
+  can_evaluatePhases(&bus, BENCH_TICK, BENCH_BITRATE, &unplanned);
+  bench_check(can_planPhases(&bus, BENCH_TICK, BENCH_BITRATE, &planned) == 0, "planner accepted the outboxes");
+  bench_metric("planner_peak_frames_unplanned", unplanned.peakFrames, true);
+  bench_metric("planner_peak_frames", planned.peakFrames, true);
+  bench_metric("planner_worst_queue_delay_us", planned.worstQueueDelay * 1e6, true);
+}
+
+/* signal decode, IMU, faults ============================================ */
+
+static void bench_signalDecode() {
+  CanInbox inbox;
+  const uint8_t payload[8] = {0x34, 0x12, 0xF0, 0xFF, 0x10, 0x27, 0x00, 0x80};
+  memcpy(inbox.data, payload, 8);
+  inbox.dlc = 8;
+  CanInbox *volatile source = &inbox; // reloaded every iteration so the decode is not hoisted out of the loop
+
+  bench_run("can_read_float", "signal", 20000000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i += 4) {
+      CanInbox *in = source;
+      floatSink = can_readFloat(uint16_t, in, 0, 0.01f);
+      floatSink = can_readFloat(int16_t, in, 2, 0.01f);
+      floatSink = can_readFloat(uint16_t, in, 4, 0.001f);
+      floatSink = can_readFloat(int16_t, in, 6, 0.1f);
+    }
+  });
+
+  bench_run("can_decode_signal", "signal", 20000000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i += 4) {
+      const uint8_t *data = source->data;
+      floatSink = can_decodeSignal<uint16_t>(data + 0, 0.01f);
+      floatSink = can_decodeSignal<int16_t>(data + 2, 0.01f);
+      floatSink = can_decodeSignal<uint16_t>(data + 4, 0.001f);
+      floatSink = can_decodeSignal<int16_t>(data + 6, 0.1f);
+    }
+  });
+  bench_check(can_decodeSignal<int16_t>(inbox.data + 2, 0.01f) == can_readFloat(int16_t, &inbox, 2, 0.01f),
+              "decodeSignal matches readFloat");
+}
+
+static void bench_imu() {
+  static SPI_HandleTypeDef hspi;
+  const uint8_t gyro[6] = {0x00, 0x01, 0x00, 0xFF, 0x80, 0x00};
+  const uint8_t accel[6] = {0x0A, 0x00, 0xF6, 0xFF, 0x00, 0x08};
+  host_spiSetRegisters(0x22, gyro, 6);
+  host_spiSetRegisters(0x28, accel, 6);
+  imu_init(&hspi);
+
+  xyz a;
+  xyz g;
+  bench_run("imu_sample", "sample", 1000000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+      imu_getAccel(&a);
+      imu_getGyro(&g);
+      floatSink = a.x + g.z;
+    }
+  });
+  bench_check(a.z > 9.0f && a.z < 10.5f, "accel z decoded to about 1 g");
+}
+
+static void bench_faults() {
+  static volatile uint32_t bits[4] = {FAULT_VCU_INV, FAULT_VCU_CAN_BAD_RX, FAULT_VCU_GPS_TIMEOUT,
+                                      FAULT_VCU_CELL_QUEUE_FULL};
+  bench_run("fault_set_check_clear", "operation", 50000000, [&](uint64_t ops) {
+    uint32_t active = 0;
+    for (uint64_t i = 0; i < ops; i += 3) {
+      uint32_t fault = bits[i & 3];
+      FAULT_SET(&faultVector, fault);
+      active += FAULT_CHECK(&faultVector, fault);
+      FAULT_CLEAR(&faultVector, fault);
+    }
+    intSink = active;
+  });
+  bench_check(faultVector == 0, "faults cleared");
+}
+
+/* delta codec ============================================================ */
+
+#define BENCH_CELLS 140
+#define BENCH_CELL_BLOCK 8
+#define BENCH_CELL_BLOCKS ((BENCH_CELLS + BENCH_CELL_BLOCK - 1) / BENCH_CELL_BLOCK)
+
+static uint32_t benchRandom = 0x12345678;
+
+static uint32_t bench_random() {
+  benchRandom ^= benchRandom << 13;
+  benchRandom ^= benchRandom >> 17;
+  benchRandom ^= benchRandom << 5;
+  return benchRandom;
+}
+
+/**
+ * Random walk of cell voltages in mV between low and high, each cell moving by 1 mV now and then.
+ */
+static void bench_stepCells(uint16_t *cells, uint32_t changePercent, uint16_t low, uint16_t high) {
+  for (uint32_t i = 0; i < BENCH_CELLS; i++) {
+    uint32_t r = bench_random();
+    if (r % 100 < changePercent) {
+      cells[i] += (r & 0x100) ? 1 : -1;
+      cells[i] = (cells[i] < low) ? low : (cells[i] > high) ? high : cells[i];
+    }
+  }
+}
+
+static void bench_fillCells(uint16_t *cells, uint16_t low, uint16_t high) {
+  for (uint32_t i = 0; i < BENCH_CELLS; i++) {
+    cells[i] = low + bench_random() % (high - low + 1);
+  }
+}
+
+/**
+ * Send a random walk of cells between low and high over a pair of connected buses for 1000 ticks, then hold
+ * them still until the decoder has caught up.
+ * @return Frames per tick while the cells were moving
+ */
+static double bench_deltaEndToEnd(uint16_t low, uint16_t high, uint32_t *mismatchTicks, uint32_t *catchUpTicks,
+                                  uint32_t *partFrames) {
+  static uint16_t cells[BENCH_CELLS];
+  static uint16_t decoded[BENCH_CELLS];
+  static HostCanHandle encoderHandle;
+  static HostCanHandle decoderHandle;
+  static CanBus encoderBus;
+  static CanBus decoderBus;
+  static CanInbox inboxes[BENCH_CELL_BLOCKS];
+  static DeltaEncoder encoder;
+  static DeltaDecoder decoder;
+  encoderBus = CanBus();
+  decoderBus = CanBus();
+  encoder = DeltaEncoder();
+  decoder = DeltaDecoder();
+  host_canReset(&encoderHandle);
+  host_canReset(&decoderHandle);
+  host_canConnect(&encoderHandle, &decoderHandle);
+  can_busInit(&encoderBus, &encoderHandle);
+  can_busInit(&decoderBus, &decoderHandle);
+  can_busAddInboxes(&decoderBus, HVC_VCU_CELL_VOLTAGES_START, HVC_VCU_CELL_VOLTAGES_START + BENCH_CELL_BLOCKS - 1,
+                    inboxes);
+  bench_check(delta_initEncoder(&encoder, &encoderBus, HVC_VCU_CELL_VOLTAGES_START, BENCH_CELLS, BENCH_CELL_BLOCK,
+                                1.0f) == 0, "delta encoder set up");
+  bench_check(delta_initDecoder(&decoder, inboxes, BENCH_CELLS, BENCH_CELL_BLOCK) == 0, "delta decoder set up");
+  bench_fillCells(cells, low, high);
+
+  const uint32_t ticks = 1000;
+  *mismatchTicks = 0;
+  for (uint32_t t = 0; t < ticks; t++) {
+    bench_stepCells(cells, 2, low, high);
+    delta_periodic(&encoder, cells, 0.01f);
+    can_busPeriodic(&decoderBus, 0.01f);
+    delta_update(&decoder, decoded);
+    *mismatchTicks += memcmp(cells, decoded, sizeof(cells)) != 0;
+  }
+  uint32_t framesSent = encoder.framesSent;
+
+  *catchUpTicks = 0;
+  while (memcmp(cells, decoded, sizeof(cells)) != 0 && *catchUpTicks < 100) {
+    delta_periodic(&encoder, cells, 0.01f);
+    can_busPeriodic(&decoderBus, 0.01f);
+    delta_update(&decoder, decoded);
+    (*catchUpTicks)++;
+  }
+  bench_check(decoder.saturatedBlocks == 0, "no clamped cell blocks");
+  *partFrames = encoder.partFrames;
+  return (double) framesSent / ticks;
+}
+
+static void bench_delta() {
+  static uint16_t cells[BENCH_CELLS];
+  static uint16_t decoded[BENCH_CELLS];
+  static uint8_t frames[BENCH_CELL_BLOCKS][8];
+  bench_fillCells(cells, 3690, 3710);
+
+  bench_run("delta_encode_block", "block", 2000000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+      uint32_t block = i % (BENCH_CELLS / BENCH_CELL_BLOCK);
+      intSink = delta_encodeBlock(cells + block * BENCH_CELL_BLOCK, BENCH_CELL_BLOCK, false, frames[block]);
+    }
+  });
+  bench_run("delta_decode_block", "block", 4000000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+      uint32_t block = i % (BENCH_CELLS / BENCH_CELL_BLOCK);
+      intSink = delta_decodeBlock(frames[block], decoded + block * BENCH_CELL_BLOCK, BENCH_CELL_BLOCK);
+    }
+  });
+
+  // a balanced pack (20 mV spread), compared with the 35 frames a tick of 4 raw cells each
+  uint32_t mismatchTicks, catchUpTicks, partFrames;
+  double framesPerTick = bench_deltaEndToEnd(3690, 3710, &mismatchTicks, &catchUpTicks, &partFrames);
+  bench_check(mismatchTicks == 0, "delta decoder tracks the encoder");
+  bench_check(partFrames == 0, "balanced cell blocks fit one frame");
+  bench_metric("delta_frames_per_tick", framesPerTick, true);
+  bench_metric("delta_frame_reduction", 35.0 / framesPerTick, false);
+
+  // a pack with a weak module under load (550 mV spread): blocks go out in parts, late but exact
+  framesPerTick = bench_deltaEndToEnd(3350, 3900, &mismatchTicks, &catchUpTicks, &partFrames);
+  bench_check(catchUpTicks < BENCH_CELL_BLOCK, "delta decoder catches up with a wide spread");
+  bench_check(partFrames > 0, "wide cell blocks were sent in parts");
+  bench_metric("delta_wide_frames_per_tick", framesPerTick, true);
+  bench_metric("delta_wide_stale_ticks", (double) mismatchTicks / 1000, true);
+}
+
+/* snapshot ================================================================ */
+
+#define BENCH_SIGNALS(X) \
+  X(packVoltage, HVC_VCU_PACK_STATUS, uint16_t, 0, 0.01f) \
+  X(packCurrent, HVC_VCU_PACK_STATUS, int16_t, 2, 0.01f) \
+  X(soc, HVC_VCU_PACK_STATUS, uint16_t, 4, 0.01f) \
+  X(accelX, HVC_VCU_IMU_ACCEL, int16_t, 0, 0.01f) \
+  X(accelY, HVC_VCU_IMU_ACCEL, int16_t, 2, 0.01f) \
+  X(accelZ, HVC_VCU_IMU_ACCEL, int16_t, 4, 0.01f) \
+  X(gyroX, HVC_VCU_IMU_GYRO, int16_t, 0, 0.01f) \
+  X(gyroY, HVC_VCU_IMU_GYRO, int16_t, 2, 0.01f) \
+  X(gyroZ, HVC_VCU_IMU_GYRO, int16_t, 4, 0.01f) \
+  X(phaseA, INV_CURRENT, int16_t, 0, 0.1f) \
+  X(phaseB, INV_CURRENT, int16_t, 2, 0.1f) \
+  X(phaseC, INV_CURRENT, int16_t, 4, 0.1f) \
+  X(dcCurrent, INV_CURRENT, int16_t, 6, 0.1f) \
+  X(dcVoltage, INV_VOLTAGE, int16_t, 0, 0.1f) \
+  X(lvVoltage, PDU_VCU_LVBAT, uint16_t, 0, 0.001f) \
+  X(contactors, HVC_VCU_CONTACTOR_STATUS, uint8_t, 0, 1.0f)
+
+enum { BENCH_SIGNALS(CAN_SNAPSHOT_INDEX) BENCH_SIGNAL_COUNT };
+static const CanSignal benchSignals[] = {BENCH_SIGNALS(CAN_SNAPSHOT_SIGNAL)};
+static CanSnapshot<BENCH_SIGNAL_COUNT> snapshot;
+
+static void bench_snapshot() {
+  static HostCanHandle handle;
+  static CanBus bus;
+  static CanInbox inboxes[7];
+  static const uint32_t ids[6] = {HVC_VCU_PACK_STATUS, HVC_VCU_IMU_ACCEL, HVC_VCU_IMU_GYRO, INV_CURRENT,
+                                  INV_VOLTAGE, PDU_VCU_LVBAT};
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  for (uint32_t i = 0; i < 6; i++) {
+    can_busAddInbox(&bus, ids[i], &inboxes[i], 0.1f);
+  }
+  can_busAddInbox(&bus, HVC_VCU_CONTACTOR_STATUS, &inboxes[6]);
+  bench_check(can_snapshotInit(&snapshot, &bus, benchSignals) == 0, "snapshot set up");
+
+  const uint8_t payload[8] = {0x10, 0x27, 0x64, 0x00, 0xC4, 0x09, 0x00, 0x00};
+  bench_run("snapshot_tick", "tick", 100000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+      for (uint32_t id : ids) {
+        host_canInject(&handle, HOST_CAN_RX_FIFO0, id, 8, payload);
+      }
+      can_busPeriodic(&bus, BENCH_TICK);
+      can_snapshotCapture(&snapshot);
+    }
+  });
+  bench_check(snapshot.value[SIGNAL_packVoltage] > 99.9f && snapshot.value[SIGNAL_packVoltage] < 100.1f,
+              "snapshot decoded pack voltage");
+}
+
+/* ISO-TP ================================================================== */
+
+static void bench_isotp() {
+  static HostCanHandle handleA;
+  static HostCanHandle handleB;
+  static CanBus busA;
+  static CanBus busB;
+  static IsoTpChannel sender;
+  static IsoTpChannel receiver;
+  static uint8_t message[ISOTP_MAX_LENGTH];
+  static uint8_t received[ISOTP_MAX_LENGTH];
+  host_canReset(&handleA);
+  host_canReset(&handleB);
+  host_canConnect(&handleA, &handleB);
+  host_canConnect(&handleB, &handleA);
+  host_canSetManualTx(&handleA, true);
+  host_canSetManualTx(&handleB, true);
+  can_busInit(&busA, &handleA);
+  can_busInit(&busB, &handleB);
+  bench_check(isotp_init(&sender, &busA, VCU_HVC_PARAMS, HVC_VCU_PARAMS) == 0, "ISO-TP sender set up");
+  bench_check(isotp_init(&receiver, &busB, HVC_VCU_PARAMS, VCU_HVC_PARAMS) == 0, "ISO-TP receiver set up");
+  for (uint32_t i = 0; i < ISOTP_MAX_LENGTH; i++) {
+    message[i] = (uint8_t) bench_random();
+  }
+
+  // the wire carries as many full frames per tick as the bitrate allows, shared by both directions
+  const uint32_t framesPerTick = (uint32_t) (BENCH_BITRATE * BENCH_TICK) / can_frameBits(VCU_HVC_PARAMS, 8);
+  uint32_t ticks = 0;
+  uint32_t frames = 0;
+  bool complete = true;
+  bench_run("isotp_transfer_4095", "transfer", 500, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+      isotp_receive(&receiver, received, sizeof(received));
+      isotp_send(&sender, message, ISOTP_MAX_LENGTH);
+      uint32_t framesBefore = host_canGetTxCount(&handleA) + host_canGetTxCount(&handleB);
+      ticks = 0;
+      while (receiver.rxState != ISOTP_RX_DONE && ticks < 10000) {
+        uint32_t sent = host_canFlushTx(&handleA, framesPerTick);
+        host_canFlushTx(&handleB, framesPerTick - sent);
+        can_busPeriodic(&busA, BENCH_TICK);
+        isotp_periodic(&sender, BENCH_TICK);
+        can_busPeriodic(&busB, BENCH_TICK);
+        isotp_periodic(&receiver, BENCH_TICK);
+        ticks++;
+      }
+      frames = host_canGetTxCount(&handleA) + host_canGetTxCount(&handleB) - framesBefore;
+      complete = complete && receiver.rxState == ISOTP_RX_DONE;
+    }
+  });
+  bench_check(complete && memcmp(message, received, ISOTP_MAX_LENGTH) == 0, "ISO-TP message arrived intact");
+
+  // first frame carries 6 bytes, consecutive frames 7, plus one flow control
+  uint32_t minimumFrames = 1 + (ISOTP_MAX_LENGTH - 6 + 6) / 7 + 1;
+  uint32_t minimumTicks = (minimumFrames + framesPerTick - 1) / framesPerTick;
+  bench_metric("isotp_frames_per_transfer", frames, true);
+  bench_metric("isotp_line_efficiency", (double) minimumTicks / ticks, false);
+}
+
+/* GPS ===================================================================== */
+
+static void bench_gps() {
+  static const char sentences[] =
+      "$GPRMC,123519.25,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*43\r\n"
+      "$GPGGA,123520,3016.4321,N,09744.1234,W,1,08,0.9,545.4,M,46.9,M,,*57\r\n";
+  const uint16_t length = sizeof(sentences) - 1;
+  uint32_t parsed = 0;
+  bench_run("gps_parse_sentence", "sentence", 200000, [&](uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i += 2) {
+      parsed = gps_parse((const uint8_t *) sentences, length);
+    }
+  });
+  bench_check(parsed == 2 && gps_getData()->satellites == 8, "GPS sentences parsed");
+}
+
+/* output and baseline ===================================================== */
+
+static void bench_writeJson(FILE *file) {
+  fprintf(file, "{\n  \"benchmarks\": [\n");
+  for (uint32_t i = 0; i < resultCount; i++) {
+    fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.3f, \"ops\": %llu}%s\n",
+            results[i].name, results[i].unit, results[i].nsPerOp, (unsigned long long) results[i].ops,
+            (i + 1 < resultCount) ? "," : "");
+  }
+  fprintf(file, "  ],\n  \"metrics\": [\n");
+  for (uint32_t i = 0; i < metricCount; i++) {
+    fprintf(file, "    {\"name\": \"%s\", \"value\": %.4f, \"lower_is_better\": %s}%s\n",
+            metrics[i].name, metrics[i].value, metrics[i].lowerIsBetter ? "true" : "false",
+            (i + 1 < metricCount) ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+}
+
+/**
+ * Find the number stored under key in the object named name, in a file written by bench_writeJson.
+ * @return true if found
+ */
+static bool bench_findBaseline(const std::string &json, const char *name, const char *key, double *value) {
+  size_t object = json.find(std::string("\"name\": \"") + name + "\"");
+  if (object == std::string::npos) {
+    return false;
+  }
+  size_t end = json.find('}', object);
+  size_t field = json.find(std::string("\"") + key + "\": ", object);
+  if (field == std::string::npos || field > end) {
+    return false;
+  }
+  *value = strtod(json.c_str() + field + strlen(key) + 4, nullptr);
+  return true;
+}
+
+/**
+ * @param tolerance Fractional slowdown (or metric change) still accepted
+ * @param noiseFloor Slowdown in nanoseconds per operation still accepted, whatever the fraction
+ * @return Number of regressions
+ */
+static uint32_t bench_compare(const char *path, double tolerance, double noiseFloor) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "cannot open baseline %s\n", path);
+    return 1;
+  }
+  std::string json;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    json.append(buffer, read);
+  }
+  fclose(file);
+
+  uint32_t regressions = 0;
+  for (uint32_t i = 0; i < resultCount; i++) {
+    double base;
+    if (!bench_findBaseline(json, results[i].name, "ns_per_op", &base) || base <= 0) {
+      fprintf(stderr, "%-32s no baseline\n", results[i].name);
+      continue;
+    }
+    double change = results[i].nsPerOp / base - 1;
+    bool regressed = change > tolerance && results[i].nsPerOp - base > noiseFloor;
+    regressions += regressed;
+    fprintf(stderr, "%-32s %10.2f ns -> %10.2f ns  %+6.1f%%%s\n", results[i].name, base, results[i].nsPerOp,
+            change * 100, regressed ? "  REGRESSION" : "");
+  }
+  for (uint32_t i = 0; i < metricCount; i++) {
+    double base;
+    if (!bench_findBaseline(json, metrics[i].name, "value", &base)) {
+      fprintf(stderr, "%-32s no baseline\n", metrics[i].name);
+      continue;
+    }
+    double worse = metrics[i].lowerIsBetter ? metrics[i].value - base : base - metrics[i].value;
+    bool regressed = worse > tolerance * (base < 0 ? -base : base) + 1e-9;
+    regressions += regressed;
+    fprintf(stderr, "%-32s %10.3f    -> %10.3f%s\n", metrics[i].name, base, metrics[i].value,
+            regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  const char *jsonPath = nullptr;
+  const char *baselinePath = nullptr;
+  double tolerance = 0.25;
+  double noiseFloor = 5.0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      repeats = 3;
+      scale = 20;
+      minRunNs = 1e6;
+    } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--noise-floor") == 0 && i + 1 < argc) {
+      noiseFloor = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--quick] [--json FILE] [--baseline FILE] [--tolerance FRACTION] "
+              "[--noise-floor NS]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  bench_canRx();
+  bench_canTx();
+  bench_canPlanner();
+  bench_signalDecode();
+  bench_imu();
+  bench_faults();
+  bench_delta();
+  bench_snapshot();
+  bench_isotp();
+  bench_gps();
+
+  bench_writeJson(stdout);
+  if (jsonPath) {
+    FILE *file = fopen(jsonPath, "w");
+    if (!file) {
+      fprintf(stderr, "cannot write %s\n", jsonPath);
+      return 2;
+    }
+    bench_writeJson(file);
+    fclose(file);
+  }
+
+  if (sanityFailures > 0) {
+    return 2;
+  }
+  if (baselinePath && bench_compare(baselinePath, tolerance, noiseFloor) > 0) {
+    fprintf(stderr, "performance regressed against %s\n", baselinePath);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "can_gateway.h"
+
+uint32_t can_gatewayInit(CanGateway *gateway, CanBus *source) {
+  if (source->gateway != nullptr && source->gateway != gateway) {
+    return 1;
+  }
+  gateway->source = source;
+  source->gateway = gateway;
+  return 0;
+}
+
+uint32_t can_gatewayAddRoute(CanGateway *gateway, uint32_t idLow, uint32_t idHigh, CanBus *destination) {
+  if (idLow > idHigh || idHigh >= CAN_STD_ID_COUNT || destination == gateway->source) {
+    return 1;
+  }
+  for (uint32_t id = idLow; id <= idHigh; id++) {
+    if (can_busIsImmediate(gateway->source, id)) {
+      return 1; // frames from the RX interrupt are not forwarded
+    }
+  }
+
+  uint8_t index = 0;
+  while (index < gateway->destinationCount && gateway->destinations[index] != destination) {
+    index++;
+  }
+  if (index == gateway->destinationCount) {
+    if (gateway->destinationCount == CAN_GATEWAY_MAX_DESTINATIONS) {
+      return 1;
+    }
+    gateway->destinations[gateway->destinationCount++] = destination;
+  }
+
+  for (uint32_t id = idLow; id <= idHigh; id++) {
+    gateway->routes[id] |= (1 << index);
+  }
+  return 0;
+}
+
+void can_gatewayForward(CanGateway *gateway, uint32_t id, uint8_t dlc, const uint8_t *data, uint32_t timestamp) {
+  if (id >= CAN_STD_ID_COUNT) {
+    return;
+  }
+  uint8_t mask = gateway->routes[id];
+  if (mask == 0) {
+    return;
+  }
+
+  for (uint8_t index = 0; mask != 0; index++, mask >>= 1) {
+    if (mask & 1) {
+      if (can_busSend(gateway->destinations[index], id, dlc, data) == 0) {
+        gateway->stats.forwarded++;
+      } else {
+        gateway->stats.dropped++;
+      }
+    }
+  }
+
+#ifdef H7_SERIES
+  // the timestamp counter is 16 bits wide
+  uint32_t latency = (HAL_FDCAN_GetTimestampCounter(gateway->source->handle) - timestamp) & 0xFFFF;
+  gateway->stats.latencySamples++;
+  gateway->stats.latencyLast = latency;
+  gateway->stats.latencyTotal += latency;
+  if (latency > gateway->stats.latencyMax) {
+    gateway->stats.latencyMax = latency;
+  }
+#else
+  (void) timestamp;
+#endif
+}
+
+float can_gatewayGetAverageLatency(const CanGateway *gateway) {
+  if (gateway->stats.latencySamples == 0) {
+    return 0;
+  }
+  return ((float) gateway->stats.latencyTotal) / ((float) gateway->stats.latencySamples);
+}
+
+void can_gatewayResetStats(CanGateway *gateway) {
+  gateway->stats = CanGatewayStats();
+}
@@ -0,0 +1,71 @@
+#ifndef LONGHORN_LIBRARY_2024_CAN_GATEWAY_H
+#define LONGHORN_LIBRARY_2024_CAN_GATEWAY_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+#define CAN_GATEWAY_MAX_DESTINATIONS 8 // one bit per destination in the routing table
+#define CAN_STD_ID_COUNT 0x800
+
+typedef struct CanGatewayStats {
+  uint32_t forwarded = 0;
+  uint32_t dropped = 0; // destination Tx FIFO was full or the send failed
+  uint32_t latencySamples = 0;
+  uint32_t latencyLast = 0;
+  uint32_t latencyMax = 0;
+  uint64_t latencyTotal = 0;
+} CanGatewayStats;
+
+/**
+ * Forwards frames received on one bus to other buses.\n
+ * Routes are resolved when they are added: every standard ID has a byte in the routing table with one bit per
+ * destination, so forwarding a frame is a single array index. Frames are sent straight from the buffer they were
+ * read into from the hardware FIFO.\n
+ * Latency is measured in FDCAN timestamp counter ticks, from the receive timestamp to the moment the frame is
+ * queued on the destination. The timestamp counter of the source bus must be enabled for this (H7 only).
+ */
+typedef struct CanGateway {
+  CanBus *source = nullptr;
+  CanBus *destinations[CAN_GATEWAY_MAX_DESTINATIONS] = {};
+  uint8_t destinationCount = 0;
+  uint8_t routes[CAN_STD_ID_COUNT] = {};
+  CanGatewayStats stats;
+} CanGateway;
+
+/**
+ * Attach a gateway to the bus it forwards from. Frames are forwarded from can_busPeriodic of the source bus.
+ * A bus has a single gateway slot; put all routes from one bus on the same gateway.
+ * @param gateway Gateway to attach
+ * @param source Bus whose received frames are forwarded
+ * @return 0 if successful, 1 if another gateway is already attached to the source bus
+ */
+uint32_t can_gatewayInit(CanGateway *gateway, CanBus *source);
+
+/**
+ * Forward all frames with a standard ID in the given range to the destination bus.
+ * @param gateway Gateway to add the route to
+ * @param idLow First ID to forward
+ * @param idHigh Last ID to forward
+ * @param destination Bus the frames are sent on
+ * @return 0 if successful, 1 if the range is invalid, overlaps the immediate band of the source bus
+ * or there are too many destinations
+ */
+uint32_t can_gatewayAddRoute(CanGateway *gateway, uint32_t idLow, uint32_t idHigh, CanBus *destination);
+
+/**
+ * Forward a received frame according to the routing table. Called by the RX path of the source bus.
+ * @param timestamp Hardware receive timestamp of the frame
+ */
+void can_gatewayForward(CanGateway *gateway, uint32_t id, uint8_t dlc, const uint8_t *data, uint32_t timestamp);
+
+/**
+ * @return Average forwarding latency in timestamp counter ticks, 0 if nothing was forwarded yet
+ */
+float can_gatewayGetAverageLatency(const CanGateway *gateway);
+
+/**
+ * Reset forwarding counters and latency statistics.
+ */
+void can_gatewayResetStats(CanGateway *gateway);
+
+#endif //LONGHORN_LIBRARY_2024_CAN_GATEWAY_H
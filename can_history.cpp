@@ -0,0 +1,34 @@
+#include "can_history.h"
+
+void can_attachHistory(CanInbox *inbox, CanHistoryRing *history) {
+  history->_count = 0;
+  inbox->_history = history;
+}
+
+void can_historyPush(CanHistoryRing *history, uint8_t dlc, const uint8_t *data, double rxTime) {
+  CanHistoryEntry *entry = &history->entries[history->_count % history->capacity];
+  entry->rxTime = rxTime;
+  entry->dlc = dlc;
+  memcpy(entry->data, data, dlc);
+  __atomic_store_n(&history->_count, history->_count + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t can_historyCount(const CanHistoryRing *history) {
+  return __atomic_load_n(&history->_count, __ATOMIC_ACQUIRE);
+}
+
+uint16_t can_historySize(const CanHistoryRing *history) {
+  uint32_t count = can_historyCount(history);
+  return (count < history->capacity) ? (uint16_t) count : history->capacity;
+}
+
+const CanHistoryEntry *can_historyAt(const CanHistoryRing *history, uint32_t count, uint16_t age) {
+  if (age >= count || age >= history->capacity) {
+    return nullptr;
+  }
+  return &history->entries[(count - 1 - age) % history->capacity];
+}
+
+const CanHistoryEntry *can_historyGet(const CanHistoryRing *history, uint16_t age) {
+  return can_historyAt(history, can_historyCount(history), age);
+}
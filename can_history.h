@@ -0,0 +1,193 @@
+#ifndef LONGHORN_LIBRARY_2024_CAN_HISTORY_H
+#define LONGHORN_LIBRARY_2024_CAN_HISTORY_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Fixed-depth history of the frames received by an inbox, for derivatives and filtering
+ * (e.g. wheel speed from UNS*_VCU_MAGNET, rate of change of HVC_VCU_PACK_STATUS).\n
+ * The RX path appends every frame the inbox receives. Entries are read in place, newest first.
+ * Frames are stamped with their hardware RX timestamp if the bus has one (can_busSetTimestampPeriod), otherwise
+ * all frames emptied by one can_busPeriodic call share its bus time.
+ * If the inbox is in the immediate band the oldest entries can be overwritten while they are being read.
+ *
+ *   static CanInbox packStatus;
+ *   static CanHistory<32> packStatusHistory;
+ *   can_addInbox(HVC_VCU_PACK_STATUS, &packStatus);
+ *   can_attachHistory(&packStatus, &packStatusHistory);
+ *   float dVdt = can_historySlope<uint16_t>(&packStatusHistory, 0, 0.01f, 8);
+ */
+
+typedef struct CanHistoryEntry {
+  double rxTime;
+  uint8_t dlc;
+  uint8_t data[8];
+} CanHistoryEntry;
+
+/**
+ * Capacity-independent part of a history. The entries point into the CanHistory that owns them.
+ */
+typedef struct CanHistoryRing {
+  CanHistoryEntry *entries = nullptr;
+  uint16_t capacity = 0;
+  uint32_t _count = 0; // frames pushed since the history was attached
+} CanHistoryRing;
+
+template<uint16_t N>
+struct CanHistory : CanHistoryRing {
+  CanHistoryEntry _storage[N] = {};
+
+  CanHistory() {
+    entries = _storage;
+    capacity = N;
+  }
+
+  CanHistory(const CanHistory &) = delete;
+  CanHistory &operator=(const CanHistory &) = delete;
+};
+
+/**
+ * Start recording every frame the inbox receives into the given history.
+ */
+void can_attachHistory(CanInbox *inbox, CanHistoryRing *history);
+
+/**
+ * Append a frame. Called by the RX path.
+ */
+void can_historyPush(CanHistoryRing *history, uint8_t dlc, const uint8_t *data, double rxTime);
+
+/**
+ * @return Number of frames pushed so far. Read it once and pass it to can_historyAt, so that a frame pushed by
+ * the RX interrupt in the meantime does not shift the ages halfway through a calculation.
+ */
+uint32_t can_historyCount(const CanHistoryRing *history);
+
+/**
+ * @return Number of frames currently held, at most the capacity
+ */
+uint16_t can_historySize(const CanHistoryRing *history);
+
+/**
+ * @param count Value returned by can_historyCount
+ * @param age 0 for the newest frame at that count, 1 for the one before, ...
+ * @return The frame, nullptr if the history does not reach that far back
+ */
+const CanHistoryEntry *can_historyAt(const CanHistoryRing *history, uint32_t count, uint16_t age);
+
+/**
+ * @param age 0 for the newest frame, 1 for the one before, ...
+ * @return The frame, nullptr if the history does not reach that far back
+ */
+const CanHistoryEntry *can_historyGet(const CanHistoryRing *history, uint16_t age);
+
+/**
+ * @return Whether the frame is long enough to hold a T at startByte
+ */
+template<typename T>
+bool can_historyHolds(const CanHistoryEntry *entry, uint8_t startByte) {
+  return startByte + sizeof(T) <= entry->dlc;
+}
+
+/**
+ * Decode one value from each of the newest frames.
+ * @param startByte First byte of the value in the frame
+ * @param precision The amount of decimal places to read
+ * @param values Where the values are written, newest first
+ * @param count Number of values wanted
+ * @return Number of values written, which stops early at a frame too short to hold the value
+ */
+template<typename T>
+uint16_t can_historyLatest(const CanHistoryRing *history, uint8_t startByte, float precision,
+                           float *values, uint16_t count) {
+  uint32_t pushed = can_historyCount(history);
+  for (uint16_t age = 0; age < count; age++) {
+    const CanHistoryEntry *entry = can_historyAt(history, pushed, age);
+    if (entry == nullptr || !can_historyHolds<T>(entry, startByte)) {
+      return age;
+    }
+    values[age] = can_decodeSignal<T>(entry->data + startByte, precision);
+  }
+  return count;
+}
+
+/**
+ * Least-squares slope of a value over the newest frames, in units per second.
+ * @param count Number of frames to fit, fewer if a frame too short to hold the value comes first
+ * @return The slope, 0 if there are fewer than 2 frames or they share one timestamp
+ */
+template<typename T>
+float can_historySlope(const CanHistoryRing *history, uint8_t startByte, float precision, uint16_t count) {
+  uint32_t pushed = can_historyCount(history);
+  uint16_t held = 0;
+  while (held < count && can_historyAt(history, pushed, held) != nullptr &&
+         can_historyHolds<T>(can_historyAt(history, pushed, held), startByte)) {
+    held++;
+  }
+  count = held;
+  if (count < 2) {
+    return 0;
+  }
+
+  // times relative to the newest frame keep the sums small
+  double newest = can_historyAt(history, pushed, 0)->rxTime;
+  float meanT = 0, meanV = 0;
+  for (uint16_t age = 0; age < count; age++) {
+    const CanHistoryEntry *entry = can_historyAt(history, pushed, age);
+    meanT += (float) (entry->rxTime - newest);
+    meanV += can_decodeSignal<T>(entry->data + startByte, precision);
+  }
+  meanT /= (float) count;
+  meanV /= (float) count;
+
+  // centred sums cannot cancel to a tiny or negative denominator
+  float sumTT = 0, sumTV = 0;
+  for (uint16_t age = 0; age < count; age++) {
+    const CanHistoryEntry *entry = can_historyAt(history, pushed, age);
+    float t = (float) (entry->rxTime - newest) - meanT;
+    sumTT += t * t;
+    sumTV += t * (can_decodeSignal<T>(entry->data + startByte, precision) - meanV);
+  }
+  if (!(sumTT > 0)) {
+    return 0;
+  }
+  return sumTV / sumTT;
+}
+
+/**
+ * Linearly interpolate a value at the given time between the two frames around it.
+ * @param time Bus time in seconds, between the oldest and the newest frame
+ * @param value Where the value is written
+ * @return true if successful, false if the time is outside the history or a frame around it is too short to
+ * hold the value
+ */
+template<typename T>
+bool can_historyInterpolate(const CanHistoryRing *history, uint8_t startByte, float precision,
+                            double time, float *value) {
+  uint32_t pushed = can_historyCount(history);
+  const CanHistoryEntry *after = can_historyAt(history, pushed, 0);
+  if (after != nullptr && after->rxTime == time && can_historyHolds<T>(after, startByte)) {
+    *value = can_decodeSignal<T>(after->data + startByte, precision);
+    return true;
+  }
+  for (uint16_t age = 1; after != nullptr; age++) {
+    const CanHistoryEntry *before = can_historyAt(history, pushed, age);
+    if (before == nullptr) {
+      break;
+    }
+    if (before->rxTime <= time && time <= after->rxTime) {
+      if (!can_historyHolds<T>(before, startByte) || !can_historyHolds<T>(after, startByte)) {
+        return false;
+      }
+      float v0 = can_decodeSignal<T>(before->data + startByte, precision);
+      float v1 = can_decodeSignal<T>(after->data + startByte, precision);
+      float span = (float) (after->rxTime - before->rxTime);
+      *value = (span > 0) ? v0 + (v1 - v0) * (float) (time - before->rxTime) / span : v1;
+      return true;
+    }
+    after = before;
+  }
+  return false;
+}
+
+#endif //LONGHORN_LIBRARY_2024_CAN_HISTORY_H
@@ -0,0 +1,131 @@
+#include "can_latency.h"
+
+uint32_t can_latencyInit(CanLatencyMonitor *monitor, CanBus *bus, float tickSeconds) {
+#ifdef H7_SERIES
+  monitor->bus = bus;
+  monitor->tickSeconds = tickSeconds;
+  bus->latency = monitor;
+  return 0;
+#else
+  (void) monitor;
+  (void) bus;
+  (void) tickSeconds;
+  return 1;
+#endif
+}
+
+void can_latencyDisable(CanLatencyMonitor *monitor) {
+  if (monitor->bus != nullptr && monitor->bus->latency == monitor) {
+    monitor->bus->latency = nullptr;
+  }
+}
+
+uint32_t can_latencyAddPair(CanLatencyMonitor *monitor, uint32_t requestId, uint32_t responseId) {
+  if (monitor->pairCount == CAN_LATENCY_MAX_PAIRS || can_busIsImmediate(monitor->bus, responseId)) {
+    return 1;
+  }
+  CanLatencyPair *pair = &monitor->pairs[monitor->pairCount++];
+  pair->requestId = requestId;
+  pair->responseId = responseId;
+  pair->isPending = false;
+  pair->roundTrip = CanLatencyHistogram();
+  return 0;
+}
+
+void can_latencyRecord(CanLatencyHistogram *histogram, uint32_t ticks) {
+  uint8_t bucket = (ticks == 0) ? 0 : (uint8_t) (32 - __builtin_clz(ticks));
+  histogram->buckets[(bucket < CAN_LATENCY_BUCKETS) ? bucket : CAN_LATENCY_BUCKETS - 1]++;
+  histogram->count++;
+  histogram->total += ticks;
+  histogram->min = (ticks < histogram->min) ? ticks : histogram->min;
+  histogram->max = (ticks > histogram->max) ? ticks : histogram->max;
+}
+
+uint8_t can_latencyOnQueue(CanLatencyMonitor *monitor, uint32_t id) {
+  // 256 is a multiple of CAN_LATENCY_MARKERS, so the counter may wrap on its own
+  uint8_t marker = __atomic_fetch_add(&monitor->_marker, 1, __ATOMIC_RELAXED) % CAN_LATENCY_MARKERS;
+  if (monitor->_isQueued[marker]) {
+    // the event of the frame that had the marker is still unread and could be taken for this frame's
+    monitor->reusedMarkers++;
+    monitor->_isQueued[marker] = false;
+    return marker;
+  }
+#ifdef H7_SERIES
+  monitor->_queuedAt[marker] = HAL_FDCAN_GetTimestampCounter(monitor->bus->handle);
+#endif
+  monitor->_queuedId[marker] = id;
+  monitor->_isQueued[marker] = true;
+  return marker;
+}
+
+void can_latencyOnQueueFailed(CanLatencyMonitor *monitor, uint8_t marker) {
+  monitor->_isQueued[marker % CAN_LATENCY_MARKERS] = false;
+}
+
+void can_latencyOnReceive(CanLatencyMonitor *monitor, uint32_t id, uint32_t timestamp) {
+  for (uint8_t i = 0; i < monitor->pairCount; i++) {
+    CanLatencyPair *pair = &monitor->pairs[i];
+    if (pair->isPending && pair->responseId == id) {
+      can_latencyRecord(&pair->roundTrip, (uint16_t) (timestamp - pair->requestTimestamp));
+      pair->isPending = false;
+    }
+  }
+}
+
+#ifdef H7_SERIES
+/**
+ * Account for one frame that made it onto the bus.
+ */
+static void can_latencyOnTransmit(CanLatencyMonitor *monitor, uint8_t marker, uint16_t timestamp) {
+  if (marker >= CAN_LATENCY_MARKERS || !monitor->_isQueued[marker]) {
+    monitor->lostEvents++;
+    return;
+  }
+  monitor->_isQueued[marker] = false;
+  can_latencyRecord(&monitor->queueing, (uint16_t) (timestamp - monitor->_queuedAt[marker]));
+
+  uint32_t id = monitor->_queuedId[marker];
+  for (uint8_t i = 0; i < monitor->pairCount; i++) {
+    CanLatencyPair *pair = &monitor->pairs[i];
+    if (pair->requestId == id) {
+      pair->requestTimestamp = timestamp;
+      pair->isPending = true;
+    }
+  }
+}
+#endif
+
+void can_latencyProcessTxEvents(CanLatencyMonitor *monitor) {
+#ifdef H7_SERIES
+  static FDCAN_TxEventFifoTypeDef TxEvent;
+  while (HAL_FDCAN_GetTxEvent(monitor->bus->handle, &TxEvent) == HAL_OK) {
+    can_latencyOnTransmit(monitor, (uint8_t) TxEvent.MessageMarker, (uint16_t) TxEvent.TxTimestamp);
+  }
+#else
+  (void) monitor;
+#endif
+}
+
+float can_latencyToSeconds(const CanLatencyMonitor *monitor, uint32_t ticks) {
+  return (float) ticks * monitor->tickSeconds;
+}
+
+float can_latencyGetAverage(const CanLatencyMonitor *monitor, const CanLatencyHistogram *histogram) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+  return ((float) histogram->total / (float) histogram->count) * monitor->tickSeconds;
+}
+
+void can_latencyReset(CanLatencyMonitor *monitor) {
+  monitor->queueing = CanLatencyHistogram();
+  monitor->lostEvents = 0;
+  monitor->reusedMarkers = 0;
+  for (uint8_t i = 0; i < monitor->pairCount; i++) {
+    monitor->pairs[i].isPending = false;
+    monitor->pairs[i].roundTrip = CanLatencyHistogram();
+  }
+  for (uint8_t i = 0; i < CAN_LATENCY_MARKERS; i++) {
+    monitor->_isQueued[i] = false;
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef LONGHORN_LIBRARY_2024_CAN_LATENCY_H
+#define LONGHORN_LIBRARY_2024_CAN_LATENCY_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Opt-in latency measurement from FDCAN hardware timestamps (H7 only).\n
+ * While a monitor is attached, every frame sent on the bus is logged to the TX event FIFO, which gives
+ * queueing delay (queued until on the wire), and request/response pairs such as
+ * VCU_INV_PARAMS_REQUEST -> INV_VCU_PARAMS_RESPONSE give round-trip time (request on the wire until response received).\n
+ * All times are in ticks of the 16-bit FDCAN timestamp counter, so latencies must stay below 65536 ticks.
+ * The timestamp counter and the TX event FIFO have to be enabled in the FDCAN configuration.
+ */
+
+#define CAN_LATENCY_BUCKETS 17 // bucket n holds latencies of 2^(n-1) to 2^n - 1 ticks, bucket 0 holds 0
+#define CAN_LATENCY_MAX_PAIRS 8
+// frames whose TX event can still arrive: a full TX FIFO (32) and a full TX event FIFO (32), see reusedMarkers
+#define CAN_LATENCY_MARKERS 64
+
+typedef struct CanLatencyHistogram {
+  uint32_t buckets[CAN_LATENCY_BUCKETS] = {};
+  uint32_t count = 0;
+  uint32_t min = UINT32_MAX;
+  uint32_t max = 0;
+  uint64_t total = 0;
+} CanLatencyHistogram;
+
+typedef struct CanLatencyPair {
+  uint32_t requestId;
+  uint32_t responseId;
+  bool isPending;
+  uint16_t requestTimestamp;
+  CanLatencyHistogram roundTrip;
+} CanLatencyPair;
+
+typedef struct CanLatencyMonitor {
+  CanBus *bus = nullptr;
+  float tickSeconds = 0; // duration of one timestamp counter tick
+  CanLatencyHistogram queueing;
+  CanLatencyPair pairs[CAN_LATENCY_MAX_PAIRS] = {};
+  uint8_t pairCount = 0;
+  uint32_t lostEvents = 0; // TX events without a matching queued frame
+  uint32_t reusedMarkers = 0; // frames queued while their marker still waited for a TX event; neither is measured
+  uint8_t _marker = 0;
+  uint16_t _queuedAt[CAN_LATENCY_MARKERS] = {};
+  uint32_t _queuedId[CAN_LATENCY_MARKERS] = {};
+  bool _isQueued[CAN_LATENCY_MARKERS] = {};
+} CanLatencyMonitor;
+
+/**
+ * Attach a monitor to a bus. From now on every frame sent on the bus requests a TX event.
+ * @param monitor Monitor to attach
+ * @param bus Bus to measure
+ * @param tickSeconds Duration of one timestamp counter tick, used by can_latencyToSeconds
+ * @return 0 if successful, 1 if the MCU has no timestamp support
+ */
+uint32_t can_latencyInit(CanLatencyMonitor *monitor, CanBus *bus, float tickSeconds);
+
+/**
+ * Detach the monitor; frames are sent without TX events again.
+ */
+void can_latencyDisable(CanLatencyMonitor *monitor);
+
+/**
+ * Measure the time from sending requestId until receiving responseId.
+ * A new request before the response arrives restarts the measurement.
+ * @return 0 if successful, 1 if there are already CAN_LATENCY_MAX_PAIRS pairs or responseId is in the
+ * immediate band of the bus, whose frames the monitor does not see
+ */
+uint32_t can_latencyAddPair(CanLatencyMonitor *monitor, uint32_t requestId, uint32_t responseId);
+
+/**
+ * Called by can_busSend when a frame is queued.
+ * @return Message marker to put in the TX header
+ */
+uint8_t can_latencyOnQueue(CanLatencyMonitor *monitor, uint32_t id);
+
+/**
+ * Called by can_busSend when the frame given the marker could not be queued.
+ */
+void can_latencyOnQueueFailed(CanLatencyMonitor *monitor, uint8_t marker);
+
+/**
+ * Called by the RX path for every received frame.
+ */
+void can_latencyOnReceive(CanLatencyMonitor *monitor, uint32_t id, uint32_t timestamp);
+
+/**
+ * Called by can_busPeriodic. Empties the TX event FIFO into the histograms. If the event FIFO overflows between
+ * calls, the markers of the lost events are counted in reusedMarkers when they come around again.
+ */
+void can_latencyProcessTxEvents(CanLatencyMonitor *monitor);
+
+/**
+ * Add one sample to a histogram.
+ */
+void can_latencyRecord(CanLatencyHistogram *histogram, uint32_t ticks);
+
+/**
+ * @return Average of the histogram in seconds, 0 if empty
+ */
+float can_latencyGetAverage(const CanLatencyMonitor *monitor, const CanLatencyHistogram *histogram);
+
+/**
+ * @return The given number of ticks in seconds
+ */
+float can_latencyToSeconds(const CanLatencyMonitor *monitor, uint32_t ticks);
+
+/**
+ * Reset all histograms and forget requests still waiting for a response.
+ */
+void can_latencyReset(CanLatencyMonitor *monitor);
+
+#endif //LONGHORN_LIBRARY_2024_CAN_LATENCY_H
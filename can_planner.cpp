@@ -0,0 +1,151 @@
+#include "can_planner.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+typedef struct PlanEntry {
+  uint32_t id;
+  CanOutbox *outbox;
+  uint32_t period; // ticks
+  uint32_t offset; // ticks
+  uint32_t bits;
+} PlanEntry;
+
+static PlanEntry entries[CAN_PLAN_MAX_OUTBOXES];
+static uint16_t slotFrames[CAN_PLAN_MAX_SLOTS];
+static uint16_t slotBits[CAN_PLAN_MAX_SLOTS];
+
+uint32_t can_frameBits(uint32_t id, uint8_t dlc) {
+  // SOF to CRC is stuffed, CRC delimiter to interframe space is not
+  uint32_t stuffed = ((id > 0x7FF) ? 54 : 34) + 8 * dlc;
+  return stuffed + 13 + (stuffed - 1) / 4;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * Copy the outboxes of the bus into entries, shortest period first, and return how many there are.
+ */
+static uint32_t can_planCollect(CanBus *bus, float tickPeriod, uint32_t *slotCount) {
+  uint32_t count = 0;
+  uint32_t hyperperiod = 1;
+  for (const auto & [ id, outbox ] : bus->outboxes) {
+    if (count == CAN_PLAN_MAX_OUTBOXES) {
+      return CAN_PLAN_MAX_OUTBOXES + 1;
+    }
+    uint32_t period = (uint32_t) lround(outbox->period / tickPeriod);
+    period = min<uint32_t>(max<uint32_t>(period, 1), CAN_PLAN_MAX_SLOTS);
+
+    // ticks until the outbox is first due, as can_periodic will see it
+    float remaining = outbox->period - outbox->_timer;
+    uint32_t first = (remaining <= 0) ? 1 : (uint32_t) ceilf(remaining / tickPeriod);
+    first = max<uint32_t>(first, 1);
+
+    entries[count++] = {id, outbox, period, (first - 1) % period, can_frameBits(id, outbox->dlc)};
+    hyperperiod = min<uint32_t>(hyperperiod / gcd(hyperperiod, period) * period, CAN_PLAN_MAX_SLOTS);
+  }
+
+  sort(entries, entries + count, [](const PlanEntry &a, const PlanEntry &b) {
+    return (a.period != b.period) ? (a.period < b.period) : (a.id < b.id);
+  });
+  *slotCount = hyperperiod;
+  return count;
+}
+
+static void can_planPlace(const PlanEntry *entry, uint32_t slotCount) {
+  for (uint32_t slot = entry->offset; slot < slotCount; slot += entry->period) {
+    slotFrames[slot]++;
+    slotBits[slot] += entry->bits;
+  }
+}
+
+static void can_planReport(uint32_t count, uint32_t slotCount, float tickPeriod, uint32_t bitrate,
+                           CanPlanReport *report) {
+  fill(slotFrames, slotFrames + slotCount, 0);
+  fill(slotBits, slotBits + slotCount, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    can_planPlace(&entries[i], slotCount);
+  }
+
+  float slotCapacity = (float) bitrate * tickPeriod;
+  uint32_t totalFrames = 0, totalBits = 0, peakBits = 0;
+  report->peakFrames = 0;
+  for (uint32_t slot = 0; slot < slotCount; slot++) {
+    totalFrames += slotFrames[slot];
+    totalBits += slotBits[slot];
+    report->peakFrames = max<uint32_t>(report->peakFrames, slotFrames[slot]);
+    peakBits = max<uint32_t>(peakBits, slotBits[slot]);
+  }
+
+  // run the schedule twice so that backlog carried over the end of the hyperperiod is accounted for
+  float backlog = 0, worstBits = 0;
+  for (uint32_t i = 0; i < 2 * slotCount; i++) {
+    float due = backlog + (float) slotBits[i % slotCount];
+    worstBits = max(worstBits, due);
+    backlog = max(0.0f, due - slotCapacity);
+  }
+
+  report->outboxCount = count;
+  report->slotCount = slotCount;
+  report->averageFrames = (float) totalFrames / (float) slotCount;
+  report->peakUtilisation = (float) peakBits / slotCapacity;
+  report->averageUtilisation = (float) totalBits / ((float) slotCount * slotCapacity);
+  report->worstQueueDelay = worstBits / (float) bitrate;
+}
+
+uint32_t can_evaluatePhases(CanBus *bus, float tickPeriod, uint32_t bitrate, CanPlanReport *report) {
+  uint32_t slotCount;
+  uint32_t count = can_planCollect(bus, tickPeriod, &slotCount);
+  if (count > CAN_PLAN_MAX_OUTBOXES) {
+    return 1;
+  }
+  can_planReport(count, slotCount, tickPeriod, bitrate, report);
+  return 0;
+}
+
+uint32_t can_planPhases(CanBus *bus, float tickPeriod, uint32_t bitrate, CanPlanReport *report) {
+  uint32_t slotCount;
+  uint32_t count = can_planCollect(bus, tickPeriod, &slotCount);
+  if (count > CAN_PLAN_MAX_OUTBOXES) {
+    return 1;
+  }
+
+  // greedy: place the most frequent outboxes first, each at the offset whose busiest slot is the least loaded
+  fill(slotFrames, slotFrames + slotCount, 0);
+  fill(slotBits, slotBits + slotCount, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    PlanEntry *entry = &entries[i];
+    uint32_t bestOffset = 0, bestFrames = UINT32_MAX, bestBits = UINT32_MAX;
+    for (uint32_t offset = 0; offset < entry->period && offset < slotCount; offset++) {
+      uint32_t frames = 0, bits = 0;
+      for (uint32_t slot = offset; slot < slotCount; slot += entry->period) {
+        frames = max<uint32_t>(frames, slotFrames[slot]);
+        bits = max<uint32_t>(bits, slotBits[slot]);
+      }
+      if (frames < bestFrames || (frames == bestFrames && bits < bestBits)) {
+        bestOffset = offset;
+        bestFrames = frames;
+        bestBits = bits;
+      }
+    }
+    entry->offset = bestOffset;
+    can_planPlace(entry, slotCount);
+
+    // due on the (offset + 1)th can_periodic call from now; the half tick absorbs timing jitter
+    entry->outbox->_timer = entry->outbox->period - ((float) bestOffset + 0.5f) * tickPeriod;
+    entry->outbox->_timer = max(entry->outbox->_timer, 0.0f);
+  }
+
+  if (report != nullptr) {
+    can_planReport(count, slotCount, tickPeriod, bitrate, report);
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef LONGHORN_LIBRARY_2024_CAN_PLANNER_H
+#define LONGHORN_LIBRARY_2024_CAN_PLANNER_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Phase planning for the periodic outboxes of a bus.\n
+ * Time is split into slots of one can_periodic tick. Every outbox is due in the slots
+ * offset, offset + period, offset + 2 * period, ... and the planner picks offsets so that the number of frames
+ * (and then bits) due in the busiest slot is as small as possible. This spreads outboxes that share a period,
+ * or have harmonic periods, across the ticks instead of queueing them all at once.
+ */
+
+#ifndef CAN_PLAN_MAX_SLOTS
+#define CAN_PLAN_MAX_SLOTS 1000 // longest hyperperiod in ticks, longer schedules are approximated
+#endif
+#define CAN_PLAN_MAX_OUTBOXES 128
+
+typedef struct CanPlanReport {
+  uint32_t outboxCount = 0;
+  uint32_t slotCount = 0; // hyperperiod of the outbox periods in ticks
+  uint32_t peakFrames = 0; // most frames due in one slot
+  float averageFrames = 0;
+  float peakUtilisation = 0; // bits due in the busiest slot / bits the bus can carry in one slot
+  float averageUtilisation = 0;
+  float worstQueueDelay = 0; // seconds the last frame of the worst slot waits before it is on the wire
+} CanPlanReport;
+
+/**
+ * Assign the phase (the _timer) of every outbox on the bus, then report the resulting load.
+ * Call after all outboxes have been added.
+ * @param bus Bus whose outboxes are planned
+ * @param tickPeriod Time between can_periodic calls in seconds
+ * @param bitrate Nominal bitrate of the bus in bits per second
+ * @param report Load with the new phases, may be nullptr
+ * @return 0 if successful, 1 if there are more than CAN_PLAN_MAX_OUTBOXES outboxes
+ */
+uint32_t can_planPhases(CanBus *bus, float tickPeriod, uint32_t bitrate, CanPlanReport *report);
+
+/**
+ * Report the load of the outboxes on the bus with their current phases, without changing them.
+ * @return 0 if successful, 1 if there are more than CAN_PLAN_MAX_OUTBOXES outboxes
+ */
+uint32_t can_evaluatePhases(CanBus *bus, float tickPeriod, uint32_t bitrate, CanPlanReport *report);
+
+/**
+ * @return Worst-case length of a data frame on the wire in bits, including stuff bits and interframe space
+ */
+uint32_t can_frameBits(uint32_t id, uint8_t dlc);
+
+#endif //LONGHORN_LIBRARY_2024_CAN_PLANNER_H
@@ -0,0 +1,99 @@
+#include "can_snapshot.h"
+
+uint32_t can_snapshotInit(CanSnapshotBase *snapshot, CanBus *bus, const CanSignal *signals) {
+  snapshot->_bus = bus;
+  snapshot->_signals = signals;
+  snapshot->groupCount = 0;
+
+  // one group per inbox, in order of first appearance
+  for (uint16_t i = 0; i < snapshot->signalCount; i++) {
+    auto it = bus->inboxes.find(signals[i].id);
+    if (it == bus->inboxes.end() || (it->second->_snapshot != nullptr && it->second->_snapshot != snapshot)) {
+      return 1;
+    }
+    uint16_t group = 0;
+    while (group < snapshot->groupCount && snapshot->_groups[group].id != signals[i].id) {
+      group++;
+    }
+    if (group == snapshot->groupCount) {
+      snapshot->_groups[group] = {signals[i].id, it->second, 0, 0};
+      snapshot->groupCount++;
+    }
+    snapshot->timeLimit[i] = it->second->timeLimit;
+  }
+
+  uint16_t position = 0;
+  for (uint16_t group = 0; group < snapshot->groupCount; group++) {
+    CanSnapshotGroup *thisGroup = &snapshot->_groups[group];
+    thisGroup->first = position;
+    for (uint16_t i = 0; i < snapshot->signalCount; i++) {
+      if (signals[i].id == thisGroup->id) {
+        snapshot->_order[position++] = i;
+      }
+    }
+    thisGroup->count = position - thisGroup->first;
+  }
+
+  // the group has to be in place before the RX path can see the snapshot
+  for (uint16_t word = 0; word < (snapshot->groupCount + 31) / 32; word++) {
+    snapshot->_dirty[word] = 0;
+  }
+  for (uint16_t group = 0; group < snapshot->groupCount; group++) {
+    CanInbox *inbox = snapshot->_groups[group].inbox;
+    inbox->_snapshotGroup = group;
+    __atomic_store_n(&inbox->_snapshot, snapshot, __ATOMIC_RELEASE);
+    if (can_getInboxSequence(inbox) != 0) {
+      can_snapshotMarkDirty(snapshot, group); // frames received before now count as new
+    }
+  }
+  return 0;
+}
+
+void can_snapshotMarkDirty(CanSnapshotBase *snapshot, uint16_t group) {
+  __atomic_fetch_or(&snapshot->_dirty[group / 32], 1u << (group % 32), __ATOMIC_RELEASE);
+}
+
+static void can_snapshotDecodeGroup(CanSnapshotBase *snapshot, const CanSnapshotGroup *group) {
+  CanFrame frame;
+  can_readInbox(group->inbox, &frame);
+  for (uint16_t i = group->first; i < group->first + group->count; i++) {
+    uint16_t index = snapshot->_order[i];
+    const CanSignal *signal = &snapshot->_signals[index];
+    if (signal->startByte + signal->size > frame.dlc) {
+      continue;
+    }
+    snapshot->value[index] = signal->decode(frame.data + signal->startByte, signal->precision);
+    snapshot->rxTime[index] = frame.rxTime;
+    snapshot->valid[index / 32] |= 1u << (index % 32);
+  }
+}
+
+uint32_t can_snapshotCapture(CanSnapshotBase *snapshot) {
+  snapshot->time = snapshot->_bus->time;
+  uint32_t decoded = 0;
+  for (uint16_t word = 0; word < (snapshot->groupCount + 31) / 32; word++) {
+    // a frame that arrives after the exchange sets its bit again and is decoded (once more) next time
+    uint32_t dirty = __atomic_exchange_n(&snapshot->_dirty[word], 0, __ATOMIC_ACQUIRE);
+    while (dirty != 0) {
+      uint16_t group = word * 32 + __builtin_ctz(dirty);
+      dirty &= dirty - 1;
+      if (group >= snapshot->groupCount) {
+        continue; // an inbox this snapshot read before it was set up again
+      }
+      can_snapshotDecodeGroup(snapshot, &snapshot->_groups[group]);
+      decoded++;
+    }
+  }
+  return decoded;
+}
+
+float can_snapshotGetAge(const CanSnapshotBase *snapshot, uint16_t signal) {
+  return (float) (snapshot->time - snapshot->rxTime[signal]);
+}
+
+bool can_snapshotIsValid(const CanSnapshotBase *snapshot, uint16_t signal) {
+  if ((snapshot->valid[signal / 32] & (1u << (signal % 32))) == 0) {
+    return false;
+  }
+  return snapshot->timeLimit[signal] == 0 || can_snapshotGetAge(snapshot, signal) <= snapshot->timeLimit[signal];
+}
@@ -0,0 +1,120 @@
+#ifndef LONGHORN_LIBRARY_2024_CAN_SNAPSHOT_H
+#define LONGHORN_LIBRARY_2024_CAN_SNAPSHOT_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Decoded copy of the vehicle state, taken at one point in time.\n
+ * Signals are described once with an X-macro, which generates both their indices and their decoders:
+ *
+ *   #define VCU_SIGNALS(X) \
+ *     X(packVoltage, HVC_VCU_PACK_STATUS, uint16_t, 0, 0.01f) \
+ *     X(packCurrent, HVC_VCU_PACK_STATUS, int16_t, 2, 0.01f)
+ *   enum { VCU_SIGNALS(CAN_SNAPSHOT_INDEX) VCU_SIGNAL_COUNT };
+ *   static const CanSignal vcuSignals[] = { VCU_SIGNALS(CAN_SNAPSHOT_SIGNAL) };
+ *   static CanSnapshot<VCU_SIGNAL_COUNT> snapshot;
+ *
+ * The RX path sets a dirty bit for the inbox's group with every frame, and can_snapshotCapture decodes only the
+ * dirty groups into structure-of-arrays storage (snapshot.value[SIGNAL_packVoltage], ...), so control code can
+ * work on a coherent copy that does not change underneath it, and a capture costs what changed, not what is
+ * registered.
+ */
+
+#define CAN_SNAPSHOT_INDEX(name, id, type, startByte, precision) SIGNAL_##name,
+#define CAN_SNAPSHOT_SIGNAL(name, id, type, startByte, precision) \
+  {id, startByte, sizeof(type), precision, can_decodeSignal<type>},
+
+typedef float (*CanSignalDecoder)(const uint8_t *data, float precision);
+
+typedef struct CanSignal {
+  uint32_t id;
+  uint8_t startByte;
+  uint8_t size;
+  float precision;
+  CanSignalDecoder decode;
+} CanSignal;
+
+typedef struct CanSnapshotGroup {
+  uint32_t id;
+  CanInbox *inbox;
+  uint16_t first; // into order
+  uint16_t count;
+} CanSnapshotGroup;
+
+/**
+ * Storage-independent part of a snapshot. The arrays point into the CanSnapshot that owns them.
+ */
+typedef struct CanSnapshotBase {
+  double time = 0; // bus time of the last capture
+  uint16_t signalCount = 0;
+  uint16_t groupCount = 0;
+  float *value = nullptr;
+  double *rxTime = nullptr; // bus time the frame holding the signal was received
+  float *timeLimit = nullptr; // timeout of the inbox holding the signal, 0 if none
+  uint32_t *valid = nullptr; // bit per signal, set once the signal has been decoded
+  uint32_t *_dirty = nullptr; // bit per group, set by the RX path, cleared by can_snapshotCapture
+  const CanSignal *_signals = nullptr;
+  CanBus *_bus = nullptr;
+  CanSnapshotGroup *_groups = nullptr;
+  uint16_t *_order = nullptr; // signal indices sorted by group
+} CanSnapshotBase;
+
+template<uint16_t N>
+struct CanSnapshot : CanSnapshotBase {
+  float _value[N] = {};
+  double _rxTime[N] = {};
+  float _timeLimit[N] = {};
+  uint32_t _valid[(N + 31) / 32] = {};
+  uint32_t _dirtyStorage[(N + 31) / 32] = {};
+  CanSnapshotGroup _groupStorage[N] = {};
+  uint16_t _orderStorage[N] = {};
+
+  CanSnapshot() {
+    signalCount = N;
+    value = _value;
+    rxTime = _rxTime;
+    timeLimit = _timeLimit;
+    valid = _valid;
+    _dirty = _dirtyStorage;
+    _groups = _groupStorage;
+    _order = _orderStorage;
+  }
+
+  CanSnapshot(const CanSnapshot &) = delete;
+  CanSnapshot &operator=(const CanSnapshot &) = delete;
+};
+
+/**
+ * Bind the snapshot to the inboxes holding its signals.
+ * Every signal ID must already have an inbox on the bus. The inboxes are only read, so they can still have
+ * a handler and be read by other code, but each inbox feeds at most one snapshot.
+ * @param snapshot Snapshot to set up
+ * @param bus Bus the inboxes were added on
+ * @param signals Array of snapshot->signalCount signals, must stay valid
+ * @return 0 if successful, 1 if an inbox is missing or already feeds another snapshot
+ */
+uint32_t can_snapshotInit(CanSnapshotBase *snapshot, CanBus *bus, const CanSignal *signals);
+
+/**
+ * Flag a group as received. Called by the RX path.
+ */
+void can_snapshotMarkDirty(CanSnapshotBase *snapshot, uint16_t group);
+
+/**
+ * Decode every inbox that received a frame since the last capture.
+ * @return Number of inboxes decoded
+ */
+uint32_t can_snapshotCapture(CanSnapshotBase *snapshot);
+
+/**
+ * @return Seconds between the reception of the signal and the capture
+ */
+float can_snapshotGetAge(const CanSnapshotBase *snapshot, uint16_t signal);
+
+/**
+ * @return true if the signal has been received and, if its inbox has a timeout, is not older than it
+ */
+bool can_snapshotIsValid(const CanSnapshotBase *snapshot, uint16_t signal);
+
+#endif //LONGHORN_LIBRARY_2024_CAN_SNAPSHOT_H
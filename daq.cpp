@@ -0,0 +1,227 @@
+#include "daq.h"
+#include <string.h>
+
+static DaqList lists[DAQ_MAX_LISTS];
+static CanInbox commandInbox;
+static CanBus *bus;
+static uint32_t responseId;
+static uint32_t dataId;
+
+typedef struct DaqRange {
+  uintptr_t start;
+  uintptr_t end; // one past the last readable byte
+} DaqRange;
+
+static DaqRange ranges[DAQ_MAX_RANGES];
+static uint8_t rangeCount = 0;
+static uintptr_t addressBase = 0; // 0 where pointers are 32 bits, the first range otherwise
+
+uint32_t daq_addReadableRange(const void *start, uint32_t size) {
+  uintptr_t first = reinterpret_cast<uintptr_t>(start);
+  if (rangeCount == DAQ_MAX_RANGES || size == 0) {
+    return 1;
+  }
+#if UINTPTR_MAX > UINT32_MAX
+  if (rangeCount == 0) {
+    addressBase = first;
+  }
+  if (first < addressBase || first - addressBase + size - 1 > UINT32_MAX) {
+    return 1;
+  }
+#endif
+  ranges[rangeCount++] = {first, first + size};
+  return 0;
+}
+
+uint32_t daq_getAddress(const void *variable) {
+  return (uint32_t) (reinterpret_cast<uintptr_t>(variable) - addressBase);
+}
+
+/**
+ * Turn an address from the host tool into a pointer.
+ * @return The variable, nullptr if any of its bytes is outside the readable ranges
+ */
+static const void *daq_translateAddress(uint32_t address, uint8_t size) {
+  uintptr_t first = addressBase + address;
+  for (uint8_t i = 0; i < rangeCount; i++) {
+    if (first >= ranges[i].start && first < ranges[i].end && size <= ranges[i].end - first) {
+      return reinterpret_cast<const void *>(first);
+    }
+  }
+  return nullptr;
+}
+
+uint32_t daq_clearList(uint8_t list) {
+  if (list >= DAQ_MAX_LISTS) {
+    return 1;
+  }
+  lists[list] = DaqList();
+  return 0;
+}
+
+uint32_t daq_addEntry(uint8_t list, const void *address, uint8_t size) {
+  if (list >= DAQ_MAX_LISTS) {
+    return 1;
+  }
+  DaqList *daqList = &lists[list];
+  if (daqList->isRunning || daqList->entryCount == DAQ_MAX_ENTRIES || size == 0 ||
+      daqList->byteCount + size > DAQ_MAX_LIST_BYTES) {
+    return 1;
+  }
+
+  // the packing plan: every entry knows where its bytes go, so sampling is one memcpy per entry
+  daqList->entries[daqList->entryCount++] = {static_cast<const uint8_t *>(address), size, daqList->byteCount};
+  daqList->byteCount += size;
+  daqList->frameCount = (daqList->byteCount + DAQ_FRAME_PAYLOAD - 1) / DAQ_FRAME_PAYLOAD;
+  return 0;
+}
+
+uint32_t daq_setPeriod(uint8_t list, float period) {
+  if (list >= DAQ_MAX_LISTS || period <= 0) {
+    return 1;
+  }
+  lists[list].period = period;
+  return 0;
+}
+
+uint32_t daq_start(uint8_t list) {
+  if (list >= DAQ_MAX_LISTS || lists[list].entryCount == 0) {
+    return 1;
+  }
+  lists[list]._timer = 0;
+  lists[list]._nextFrame = lists[list].frameCount;
+  lists[list].isRunning = true;
+  return 0;
+}
+
+uint32_t daq_stop(uint8_t list) {
+  if (list >= DAQ_MAX_LISTS) {
+    return 1;
+  }
+  lists[list].isRunning = false;
+  return 0;
+}
+
+const DaqList *daq_getList(uint8_t list) {
+  if (list >= DAQ_MAX_LISTS) {
+    return nullptr;
+  }
+  return &lists[list];
+}
+
+/**
+ * Inbox handler for command frames from the host tool.
+ */
+static void daq_onCommand(CanInbox *inbox, void *context) {
+  (void) context;
+  if (inbox->dlc < 2) {
+    return;
+  }
+  const uint8_t *data = inbox->data;
+  uint8_t list = data[1];
+  uint32_t status = 1;
+
+  switch (data[0]) {
+    case DAQ_CMD_CLEAR:
+      status = daq_clearList(list);
+      break;
+    case DAQ_CMD_ADD_ENTRY:
+      if (inbox->dlc >= 7) {
+        uint32_t address = data[3] | (data[4] << 8) | (data[5] << 16) | ((uint32_t) data[6] << 24);
+        const void *variable = daq_translateAddress(address, data[2]);
+        if (variable != nullptr) {
+          status = daq_addEntry(list, variable, data[2]);
+        }
+      }
+      break;
+    case DAQ_CMD_SET_PERIOD:
+      if (inbox->dlc >= 4) {
+        status = daq_setPeriod(list, (float) (data[2] | (data[3] << 8)) * 0.001f);
+      }
+      break;
+    case DAQ_CMD_START:
+      status = daq_start(list);
+      break;
+    case DAQ_CMD_STOP:
+      status = daq_stop(list);
+      break;
+    default:
+      break;
+  }
+
+  uint8_t response[3] = {data[0], list, (uint8_t) status};
+  can_busSend(bus, responseId, 3, response);
+}
+
+uint32_t daq_init(CanBus *canBus, uint32_t commandId, uint32_t response, uint32_t data) {
+  if (can_busIsImmediate(canBus, commandId)) {
+    return 1; // commands are answered with can_busSend, which is not allowed from the RX interrupt
+  }
+  bus = canBus;
+  responseId = response;
+  dataId = data;
+  can_busAddInbox(bus, commandId, &commandInbox);
+  return can_setInboxHandler(&commandInbox, daq_onCommand, nullptr);
+}
+
+/**
+ * Copy every entry into the packed list, so all frames of one sample carry values from the same moment.
+ */
+static void daq_sample(DaqList *daqList) {
+  for (uint8_t i = 0; i < daqList->entryCount; i++) {
+    const DaqEntry *entry = &daqList->entries[i];
+    memcpy(daqList->_packed + entry->offset, entry->address, entry->size);
+  }
+  daqList->_nextFrame = 0;
+}
+
+/**
+ * Send the frames of the current sample while the TX FIFO has room, like isotp_pump. Sending into a full FIFO
+ * would abort the frames already queued on bxCAN.
+ * @return 0 if successful or the FIFO is full, otherwise the error of the failed can_busSend
+ */
+static uint32_t daq_pump(uint8_t list) {
+  DaqList *daqList = &lists[list];
+  uint8_t frame[8];
+  while (daqList->_nextFrame < daqList->frameCount && can_busGetTxFreeLevel(bus) > 0) {
+    uint8_t index = daqList->_nextFrame;
+    uint8_t offset = index * DAQ_FRAME_PAYLOAD;
+    uint8_t remaining = daqList->byteCount - offset;
+    uint8_t length = (remaining > DAQ_FRAME_PAYLOAD) ? DAQ_FRAME_PAYLOAD : remaining;
+    frame[0] = (list << 4) | index;
+    memcpy(frame + 1, daqList->_packed + offset, length);
+    uint32_t error = can_busSend(bus, dataId, length + 1, frame);
+    if (error != 0) {
+      return error; // retried on the next call
+    }
+    daqList->_nextFrame++;
+  }
+  return 0;
+}
+
+uint32_t daq_periodic(float deltaTime) {
+  uint32_t result = 0;
+  for (uint8_t list = 0; list < DAQ_MAX_LISTS; list++) {
+    DaqList *daqList = &lists[list];
+    if (!daqList->isRunning) {
+      continue;
+    }
+    daqList->_timer += deltaTime;
+    if (daqList->_timer >= daqList->period) {
+      daqList->_timer -= daqList->period;
+      if (daqList->_timer >= daqList->period) {
+        daqList->_timer = 0; // we fell behind, do not try to catch up
+      }
+      if (daqList->_nextFrame < daqList->frameCount) {
+        daqList->overruns++;
+      } else {
+        daq_sample(daqList);
+      }
+    }
+    uint32_t error = daq_pump(list);
+    if (error != 0 && result == 0) {
+      result = error;
+    }
+  }
+  return result;
+}
\ No newline at end of file
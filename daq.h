@@ -0,0 +1,127 @@
+#ifndef LONGHORN_LIBRARY_2024_DAQ_H
+#define LONGHORN_LIBRARY_2024_DAQ_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * XCP-style measurement service. A host tool fills DAQ lists with memory addresses at runtime;
+ * every list is sampled at its own rate and its bytes are packed back to back into frames on the data ID.\n
+ * Data frames: byte 0 is (list << 4) | frame index, bytes 1-7 are the next 7 bytes of the packed list.\n
+ * Commands (byte 0 is the command, byte 1 the list):
+ * - 0x01 clear list
+ * - 0x02 add entry: byte 2 size, bytes 3-6 address (little endian)
+ * - 0x03 set period: bytes 2-3 period in milliseconds (little endian)
+ * - 0x04 start list
+ * - 0x05 stop list
+ * Every command is answered on the response ID with [command, list, status], status 0 on success.\n
+ * Addresses from the host tool are only read if they fall inside a range registered with daq_addReadableRange,
+ * so no entry can be added over CAN until at least one range is registered. On the MCU an address is the
+ * variable's own 32-bit address (as in the map file); where pointers are wider (host builds) it is the offset
+ * from the start of the first registered range, see daq_getAddress.
+ */
+
+#define DAQ_MAX_LISTS 4
+#define DAQ_MAX_ENTRIES 16 // per list
+#define DAQ_MAX_FRAMES 8 // per list
+#define DAQ_FRAME_PAYLOAD 7
+#define DAQ_MAX_LIST_BYTES (DAQ_MAX_FRAMES * DAQ_FRAME_PAYLOAD)
+#define DAQ_MAX_RANGES 8
+
+#define DAQ_CMD_CLEAR 0x01
+#define DAQ_CMD_ADD_ENTRY 0x02
+#define DAQ_CMD_SET_PERIOD 0x03
+#define DAQ_CMD_START 0x04
+#define DAQ_CMD_STOP 0x05
+
+typedef struct DaqEntry {
+  const uint8_t *address;
+  uint8_t size;
+  uint8_t offset; // where the entry starts in the packed list
+} DaqEntry;
+
+typedef struct DaqList {
+  DaqEntry entries[DAQ_MAX_ENTRIES] = {};
+  uint8_t entryCount = 0;
+  uint8_t byteCount = 0;
+  uint8_t frameCount = 0;
+  bool isRunning = false;
+  float period = 0.1f;
+  uint32_t overruns = 0; // samples skipped because the previous one was still being sent
+  float _timer = 0;
+  uint8_t _nextFrame = 0; // next frame of the current sample to send, frameCount once it is all out
+  uint8_t _packed[DAQ_MAX_LIST_BYTES] = {};
+} DaqList;
+
+/**
+ * Start listening for DAQ commands on the given bus.
+ * @param bus Bus the commands arrive on and the data is sent on
+ * @param commandId ID of command frames from the host tool
+ * @param responseId ID of command acknowledgements
+ * @param dataId ID of sampled data frames
+ * @return 0 if successful, 1 if commandId is in the immediate band of the bus or the command handler could not
+ * be registered
+ */
+uint32_t daq_init(CanBus *bus, uint32_t commandId = DAQ_VCU_COMMAND, uint32_t responseId = VCU_DAQ_RESPONSE,
+                  uint32_t dataId = VCU_DAQ_DATA);
+
+/**
+ * Allow the host tool to read the given memory, e.g. a struct of signals or a whole RAM section.
+ * @param start First readable byte
+ * @param size Number of readable bytes
+ * @return 0 if successful, 1 if there are too many ranges, the size is 0 or the range can't be addressed
+ * with 32 bits (on a host build: before the first range or more than 4 GiB past it)
+ */
+uint32_t daq_addReadableRange(const void *start, uint32_t size);
+
+/**
+ * @param variable Address in memory
+ * @return The 32-bit address the host tool uses for it in an add entry command
+ */
+uint32_t daq_getAddress(const void *variable);
+
+/**
+ * Remove all entries from a list and stop it.
+ * @return 0 if successful, 1 if the list does not exist
+ */
+uint32_t daq_clearList(uint8_t list);
+
+/**
+ * Append a variable to a list. Its bytes follow the previous entry directly in the packed list.
+ * @param list Index of the list
+ * @param address Address of the variable
+ * @param size Size of the variable in bytes
+ * @return 0 if successful, 1 if the list is running, full or does not exist
+ */
+uint32_t daq_addEntry(uint8_t list, const void *address, uint8_t size);
+
+/**
+ * @param period in seconds
+ * @return 0 if successful, 1 if the list does not exist or the period is not positive
+ */
+uint32_t daq_setPeriod(uint8_t list, float period);
+
+/**
+ * @return 0 if successful, 1 if the list does not exist or is empty
+ */
+uint32_t daq_start(uint8_t list);
+
+/**
+ * @return 0 if successful, 1 if the list does not exist
+ */
+uint32_t daq_stop(uint8_t list);
+
+/**
+ * @return The list with the given index, nullptr if it does not exist
+ */
+const DaqList *daq_getList(uint8_t list);
+
+/**
+ * Sample every running list whose period has elapsed and send as many of its frames as the TX FIFO has room
+ * for; the rest go out on the next calls. A list that fails to send does not hold up the others.
+ * @param deltaTime how much time in seconds has passed since last function call
+ * @return 0 if successful, otherwise the error of the first failed can_busSend
+ */
+uint32_t daq_periodic(float deltaTime);
+
+#endif //LONGHORN_LIBRARY_2024_DAQ_H
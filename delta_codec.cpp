@@ -0,0 +1,266 @@
+#include "delta_codec.h"
+
+/**
+ * Smallest and largest of count values.
+ */
+static void delta_range(const uint16_t *values, uint8_t count, uint16_t *base, uint16_t *top) {
+  *base = values[0];
+  *top = values[0];
+  for (uint8_t i = 1; i < count; i++) {
+    *base = (values[i] < *base) ? values[i] : *base;
+    *top = (values[i] > *top) ? values[i] : *top;
+  }
+}
+
+/**
+ * Bits needed for deltas up to the given spread.
+ */
+static uint8_t delta_width(uint32_t spread) {
+  return (spread == 0) ? 0 : (uint8_t) (32 - __builtin_clz(spread));
+}
+
+/**
+ * Widest delta that lets count values share the 40 payload bits of a block frame.
+ */
+static uint8_t delta_maxWidth(uint8_t count) {
+  uint8_t maxWidth = DELTA_PAYLOAD_BITS / count;
+  return (maxWidth > 16) ? 16 : maxWidth;
+}
+
+/**
+ * Number of values a part frame with the given width carries when remaining values are left in the block.
+ */
+static uint8_t delta_partLength(uint8_t width, uint8_t remaining) {
+  if (width == 0) {
+    return remaining;
+  }
+  uint8_t length = DELTA_PART_BITS / width;
+  return (length < remaining) ? length : remaining;
+}
+
+bool delta_encodeBlock(const uint16_t *values, uint8_t count, bool keyframe, uint8_t *frame) {
+  uint16_t base, top;
+  delta_range(values, count, &base, &top);
+
+  uint8_t width = delta_width(top - base);
+  uint8_t maxWidth = delta_maxWidth(count);
+  bool saturated = width > maxWidth;
+  if (saturated) {
+    width = maxWidth;
+  }
+
+  uint32_t mask = (1u << width) - 1;
+  uint64_t bits = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t delta = values[i] - base;
+    bits |= ((uint64_t) ((delta > mask) ? mask : delta)) << (i * width);
+  }
+
+  frame[0] = base & 0xFF;
+  frame[1] = base >> 8;
+  frame[2] = width | (saturated ? DELTA_FLAG_SATURATED : 0) | (keyframe ? DELTA_FLAG_KEYFRAME : 0);
+  for (uint8_t i = 0; i < 5; i++) {
+    frame[i + 3] = (uint8_t) (bits >> (i * 8));
+  }
+  return saturated;
+}
+
+uint8_t delta_encodePart(const uint16_t *values, uint8_t count, uint8_t offset, bool keyframe, uint8_t *frame) {
+  // the narrowest width whose part still fits; 16 bits always does, with at least one value
+  const uint16_t *part = values + offset;
+  uint8_t remaining = count - offset;
+  uint8_t width = 0;
+  uint8_t length;
+  uint16_t base, top;
+  for (;; width++) {
+    length = delta_partLength(width, remaining);
+    delta_range(part, length, &base, &top);
+    if (width == 16 || delta_width(top - base) <= width) {
+      break;
+    }
+  }
+
+  uint32_t bits = 0;
+  for (uint8_t i = 0; i < length && width != 0; i++) {
+    bits |= (uint32_t) (part[i] - base) << (i * width);
+  }
+
+  frame[0] = base & 0xFF;
+  frame[1] = base >> 8;
+  frame[2] = width | DELTA_FLAG_PART | (keyframe ? DELTA_FLAG_KEYFRAME : 0);
+  frame[3] = offset;
+  for (uint8_t i = 0; i < 4; i++) {
+    frame[i + 4] = (uint8_t) (bits >> (i * 8));
+  }
+  return length;
+}
+
+uint8_t delta_decodeBlock(const uint8_t *frame, uint16_t *values, uint8_t count) {
+  uint16_t base = frame[0] | (frame[1] << 8);
+  uint8_t width = frame[2] & 0x1F;
+  uint32_t mask = (1u << width) - 1;
+  uint8_t flags = frame[2] & (DELTA_FLAG_PART | DELTA_FLAG_SATURATED | DELTA_FLAG_KEYFRAME);
+
+  if (flags & DELTA_FLAG_PART) {
+    uint8_t offset = frame[3];
+    if (offset >= count) {
+      return flags;
+    }
+    uint8_t length = delta_partLength(width, count - offset);
+    uint32_t bits = frame[4] | (frame[5] << 8) | (frame[6] << 16) | ((uint32_t) frame[7] << 24);
+    for (uint8_t i = 0; i < length; i++) {
+      values[offset + i] = base + (uint16_t) (bits & mask);
+      bits >>= width;
+    }
+    return flags;
+  }
+
+  uint64_t bits = (uint64_t) frame[3] | ((uint64_t) frame[4] << 8) | ((uint64_t) frame[5] << 16) |
+                  ((uint64_t) frame[6] << 24) | ((uint64_t) frame[7] << 32);
+  for (uint8_t i = 0; i < count; i++) {
+    values[i] = base + (uint16_t) (bits & mask);
+    bits >>= width;
+  }
+  return flags;
+}
+
+/**
+ * Number of values in the given block; only the last block can be short.
+ */
+static uint8_t delta_blockLength(uint16_t valueCount, uint8_t blockSize, uint8_t block) {
+  uint16_t remaining = valueCount - block * blockSize;
+  return (remaining > blockSize) ? blockSize : (uint8_t) remaining;
+}
+
+static uint8_t delta_blockCount(uint16_t valueCount, uint8_t blockSize) {
+  return (valueCount + blockSize - 1) / blockSize;
+}
+
+uint32_t delta_initEncoder(DeltaEncoder *encoder, CanBus *bus, uint32_t idStart, uint16_t valueCount,
+                           uint8_t blockSize, float keyframePeriod) {
+  if (blockSize < 3 || blockSize > DELTA_PAYLOAD_BITS || valueCount == 0 || valueCount > DELTA_MAX_VALUES ||
+      delta_blockCount(valueCount, blockSize) > DELTA_MAX_BLOCKS) {
+    return 1;
+  }
+  encoder->bus = bus;
+  encoder->idStart = idStart;
+  encoder->valueCount = valueCount;
+  encoder->blockSize = blockSize;
+  encoder->blockCount = delta_blockCount(valueCount, blockSize);
+  encoder->keyframePeriod = keyframePeriod;
+  encoder->_keyframeTimer = keyframePeriod; // start with a keyframe
+  return 0;
+}
+
+uint32_t delta_periodic(DeltaEncoder *encoder, const uint16_t *values, float deltaTime) {
+  encoder->_keyframeTimer += deltaTime;
+  if (encoder->_keyframeTimer >= encoder->keyframePeriod) {
+    encoder->_keyframeTimer = 0;
+    encoder->_keyframeBlocks = (encoder->blockCount == 64) ? ~(uint64_t) 0
+                                                           : ((uint64_t) 1 << encoder->blockCount) - 1;
+  }
+
+  uint8_t frame[8];
+  for (uint8_t i = 0; i < encoder->blockCount; i++) {
+    uint8_t block = (encoder->_nextBlock + i) % encoder->blockCount;
+    uint16_t start = block * encoder->blockSize;
+    uint8_t length = delta_blockLength(encoder->valueCount, encoder->blockSize, block);
+
+    // a keyframe that is being sent in parts carries on where the last call stopped
+    uint64_t bit = (uint64_t) 1 << block;
+    bool keyframeBlock = (encoder->_keyframeBlocks & bit) != 0;
+    uint8_t next = keyframeBlock ? encoder->_keyframeParts[block] : 0;
+    while (!keyframeBlock && next < length && values[start + next] == encoder->_sent[start + next]) {
+      next++;
+    }
+    if (next == length) {
+      continue; // nothing changed
+    }
+    if (can_busGetTxFreeLevel(encoder->bus) == 0) {
+      encoder->_nextBlock = block; // a full FIFO would abort the frames already queued on bxCAN
+      return 0;
+    }
+
+    uint16_t base, top;
+    delta_range(values + start, length, &base, &top);
+    bool part = delta_width(top - base) > delta_maxWidth(length);
+    uint8_t first = 0;
+    uint8_t count = length;
+    if (part) {
+      first = next;
+      count = delta_encodePart(values + start, length, first, keyframeBlock, frame);
+    } else {
+      delta_encodeBlock(values + start, length, keyframeBlock, frame);
+    }
+
+    uint32_t error = can_busSend(encoder->bus, encoder->idStart + block, 8, frame);
+    if (error != 0) {
+      encoder->_nextBlock = block;
+      return error;
+    }
+    encoder->framesSent++;
+    encoder->partFrames += part ? 1 : 0;
+    if (keyframeBlock && first + count < length) {
+      encoder->_keyframeParts[block] = first + count;
+    } else {
+      encoder->_keyframeParts[block] = 0;
+      encoder->_keyframeBlocks &= ~bit;
+    }
+    for (uint8_t j = first; j < first + count; j++) {
+      encoder->_sent[start + j] = values[start + j];
+    }
+  }
+  return 0;
+}
+
+/**
+ * Inbox handler: decode the frame into the decoder's own copy of its block right away, so a part is not
+ * overwritten by the next frame on the same ID before delta_update runs.
+ */
+static void delta_onFrame(CanInbox *inbox, void *context) {
+  DeltaDecoder *decoder = static_cast<DeltaDecoder *>(context);
+  uint8_t block = inbox - decoder->inboxes;
+  if (inbox->dlc != 8) {
+    return;
+  }
+  uint8_t length = delta_blockLength(decoder->valueCount, decoder->blockSize, block);
+  uint8_t flags = delta_decodeBlock(inbox->data, decoder->_values + block * decoder->blockSize, length);
+  decoder->_saturated[block] = (flags & DELTA_FLAG_SATURATED) != 0;
+  __atomic_store_n(&decoder->_pending[block], 1, __ATOMIC_RELEASE);
+}
+
+uint32_t delta_initDecoder(DeltaDecoder *decoder, CanInbox *inboxes, uint16_t valueCount, uint8_t blockSize) {
+  if (blockSize < 3 || blockSize > DELTA_PAYLOAD_BITS || valueCount == 0 || valueCount > DELTA_MAX_VALUES ||
+      delta_blockCount(valueCount, blockSize) > DELTA_MAX_BLOCKS) {
+    return 1;
+  }
+  decoder->inboxes = inboxes;
+  decoder->valueCount = valueCount;
+  decoder->blockSize = blockSize;
+  decoder->blockCount = delta_blockCount(valueCount, blockSize);
+  for (uint8_t block = 0; block < decoder->blockCount; block++) {
+    if (can_setInboxHandler(&inboxes[block], delta_onFrame, decoder) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+uint32_t delta_update(DeltaDecoder *decoder, uint16_t *values) {
+  uint32_t decoded = 0;
+  for (uint8_t block = 0; block < decoder->blockCount; block++) {
+    if (__atomic_exchange_n(&decoder->_pending[block], 0, __ATOMIC_ACQUIRE) == 0) {
+      continue;
+    }
+    uint16_t start = block * decoder->blockSize;
+    uint8_t length = delta_blockLength(decoder->valueCount, decoder->blockSize, block);
+    for (uint8_t i = 0; i < length; i++) {
+      values[start + i] = decoder->_values[start + i];
+    }
+    uint64_t bit = (uint64_t) 1 << block;
+    decoder->saturatedBlocks = decoder->_saturated[block] ? (decoder->saturatedBlocks | bit)
+                                                          : (decoder->saturatedBlocks & ~bit);
+    decoded++;
+  }
+  return decoded;
+}
\ No newline at end of file
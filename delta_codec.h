@@ -0,0 +1,133 @@
+#ifndef LONGHORN_LIBRARY_2024_DELTA_CODEC_H
+#define LONGHORN_LIBRARY_2024_DELTA_CODEC_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Compact transport for large arrays of slowly changing values, such as HVC cell voltages and temperatures.\n
+ * The array is split into blocks of blockSize values and each block travels in one frame on idStart + block:
+ * - bytes 0-1: base, the smallest value in the block (little endian)
+ * - byte 2: bits 0-4 delta width in bits (0-16), bit 6 saturated (clamped, see delta_encodeBlock), bit 7 keyframe
+ * - bytes 3-7: blockSize deltas from the base, width bits each, packed from the least significant bit
+ * A block is only sent when one of its values changed, and all blocks are sent again every keyframe period.\n
+ * If the spread of a block does not fit in 40 / blockSize bits, delta_periodic sends it in parts instead, one
+ * frame per call on the block's ID until every value has been sent exactly:
+ * - bytes 0-1: base of the part
+ * - byte 2: bits 0-4 delta width, bit 5 part, bit 7 keyframe
+ * - byte 3: index in the block of the first value in the part
+ * - bytes 4-7: deltas of the next min(32 / width, values left in the block) values (all of them if width is 0)
+ * A 16-bit spread still takes at most blockSize / 2 frames. The decoder decodes every frame as it arrives, so
+ * parts sent faster than it is polled are not lost, and values are never clamped, only late while the spread is
+ * wide. A frame lost on the bus is repaired by the next keyframe.
+ * Choose the block size from the usual spread (e.g. 8 values allow a spread of 31).\n
+ * delta_periodic only sends while the TX FIFO has room and carries the rest (a keyframe included) to the next
+ * call, starting from the block where it stopped.
+ * 140 cell voltages in blocks of 8 fit in 18 frames of the HVC_VCU_CELL_VOLTAGES range.
+ */
+
+#define DELTA_MAX_VALUES 256
+#define DELTA_MAX_BLOCKS 64
+#define DELTA_PAYLOAD_BITS 40
+#define DELTA_PART_BITS 32
+#define DELTA_FLAG_PART 0x20
+#define DELTA_FLAG_SATURATED 0x40
+#define DELTA_FLAG_KEYFRAME 0x80
+
+typedef struct DeltaEncoder {
+  CanBus *bus = nullptr;
+  uint32_t idStart = 0;
+  uint16_t valueCount = 0;
+  uint8_t blockSize = 0;
+  uint8_t blockCount = 0;
+  float keyframePeriod = 1.0f;
+  float _keyframeTimer = 0;
+  uint16_t _sent[DELTA_MAX_VALUES] = {};
+  uint64_t _keyframeBlocks = 0; // bit per block that still owes its keyframe frame(s)
+  uint8_t _keyframeParts[DELTA_MAX_BLOCKS] = {}; // next value of a keyframe being sent in parts, 0 if none
+  uint8_t _nextBlock = 0; // where the next call starts, so a busy bus does not starve the last blocks
+  uint32_t framesSent = 0;
+  uint32_t partFrames = 0; // frames that carried part of a block that was too wide for one
+} DeltaEncoder;
+
+typedef struct DeltaDecoder {
+  CanInbox *inboxes = nullptr;
+  uint16_t valueCount = 0;
+  uint8_t blockSize = 0;
+  uint8_t blockCount = 0;
+  uint64_t saturatedBlocks = 0; // bit per block, set while the last frame of the block was saturated (clamped)
+  uint16_t _values[DELTA_MAX_VALUES] = {}; // decoded by the inbox handler
+  uint8_t _pending[DELTA_MAX_BLOCKS] = {}; // set by the inbox handler, cleared when delta_update copies the block
+  uint8_t _saturated[DELTA_MAX_BLOCKS] = {};
+} DeltaDecoder;
+
+/**
+ * Encode up to 40 / width values into one frame, clamping the deltas if the spread is too wide.
+ * delta_periodic sends such blocks with delta_encodePart instead.
+ * @param values First value of the block
+ * @param count Number of values in the block
+ * @param keyframe Whether to set the keyframe flag
+ * @param frame Where the 8 bytes of the frame are written
+ * @return true if the deltas had to be clamped
+ */
+bool delta_encodeBlock(const uint16_t *values, uint8_t count, bool keyframe, uint8_t *frame);
+
+/**
+ * Encode as many values of a block as fit exactly into one part frame, starting at the given value.
+ * @param values First value of the block
+ * @param count Number of values in the block
+ * @param offset Index of the first value to encode, less than count
+ * @param keyframe Whether to set the keyframe flag
+ * @param frame Where the 8 bytes of the frame are written
+ * @return Number of values encoded, at least 1
+ */
+uint8_t delta_encodePart(const uint16_t *values, uint8_t count, uint8_t offset, bool keyframe, uint8_t *frame);
+
+/**
+ * Decode one frame into count values. A part frame only writes the values it carries.
+ * @param values First value of the block
+ * @param count Number of values in the block
+ * @return Flags byte of the frame (DELTA_FLAG_*)
+ */
+uint8_t delta_decodeBlock(const uint8_t *frame, uint16_t *values, uint8_t count);
+
+/**
+ * @param encoder Encoder to set up
+ * @param bus Bus the frames are sent on
+ * @param idStart ID of the first block, block n is sent on idStart + n
+ * @param valueCount Number of values in the array
+ * @param blockSize Values per frame, 3 to 40
+ * @param keyframePeriod in seconds
+ * @return 0 if successful, 1 if the array does not fit
+ */
+uint32_t delta_initEncoder(DeltaEncoder *encoder, CanBus *bus, uint32_t idStart, uint16_t valueCount,
+                           uint8_t blockSize, float keyframePeriod);
+
+/**
+ * Send the blocks of the array that changed since they were last sent, or every block if a keyframe is due,
+ * while the TX FIFO has room. What does not fit is sent on the next calls.
+ * @param values Array of valueCount values
+ * @param deltaTime how much time in seconds has passed since last function call
+ * @return 0 if successful, otherwise the error of the failed can_busSend
+ */
+uint32_t delta_periodic(DeltaEncoder *encoder, const uint16_t *values, float deltaTime);
+
+/**
+ * @param decoder Decoder to set up
+ * @param inboxes Inboxes added with can_addInboxes over the encoder's ID range, one per block. The decoder sets
+ * their handlers (see can_setInboxHandler) to decode every frame as it arrives.
+ * @param valueCount Number of values in the array
+ * @param blockSize Values per frame, must match the encoder
+ * @return 0 if successful, 1 if the array does not fit or the handler table is full
+ */
+uint32_t delta_initDecoder(DeltaDecoder *decoder, CanInbox *inboxes, uint16_t valueCount, uint8_t blockSize);
+
+/**
+ * Copy the blocks that received a frame since the last call into the array. A block whose frame arrives from
+ * the RX interrupt (immediate band) while it is being copied is copied again on the next call.
+ * @param values Array of valueCount values
+ * @return Number of blocks copied
+ */
+uint32_t delta_update(DeltaDecoder *decoder, uint16_t *values);
+
+#endif //LONGHORN_LIBRARY_2024_DELTA_CODEC_H
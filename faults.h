@@ -11,7 +11,7 @@ extern uint32_t faultVector;
  * @param fault
  */
 // void fault_set(uint32_t* fault_vector, uint32_t fault);
-#define FAULT_SET(fault_vector, fault) (*(fault_vector) |= (fault))
+#define FAULT_SET(fault_vector, fault) __atomic_or_fetch((fault_vector), (fault), __ATOMIC_RELAXED) // safe from interrupts
 
 /**
  * Clear a fault bit in the fault vector.
@@ -19,14 +19,14 @@ extern uint32_t faultVector;
  * @param fault
  */
 // void fault_clear(uint32_t* fault_vector, uint32_t fault);
-#define FAULT_CLEAR(fault_vector, fault) (*(fault_vector) &= ~(fault))
+#define FAULT_CLEAR(fault_vector, fault) __atomic_and_fetch((fault_vector), ~(fault), __ATOMIC_RELAXED)
 
 /**
  * Clear all fault bits in the fault vector.
  * @param fault_vector
  */
 // void fault_clearAll(uint32_t* fault_vector);
-#define FAULT_CLEARALL(fault_vector) (*(fault_vector) = 0)
+#define FAULT_CLEARALL(fault_vector) __atomic_store_n((fault_vector), 0, __ATOMIC_RELAXED)
 
 /**
  * Check if a fault bit is set in the fault vector.
@@ -35,7 +35,7 @@ extern uint32_t faultVector;
  * @return true if fault is set, false otherwise
  */
 // bool fault_check(const uint32_t* fault_vector, uint32_t fault);
-#define FAULT_CHECK(fault_vector, fault) ((*(fault_vector) & (fault)) != 0)
+#define FAULT_CHECK(fault_vector, fault) ((__atomic_load_n((fault_vector), __ATOMIC_RELAXED) & (fault)) != 0)
 
 // VCU FAULTS
 /*
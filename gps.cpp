@@ -0,0 +1,344 @@
+#include "gps.h"
+#include "angel_can.h"
+#include "faults.h"
+
+#define SENTENCE_OTHER 0
+#define SENTENCE_RMC 1
+#define SENTENCE_GGA 2
+#define SENTENCE_VTG 3
+
+#define TAG(a, b, c) (((uint32_t) (a) << 16) | ((uint32_t) (b) << 8) | (uint32_t) (c))
+
+#define KNOTS_TO_MPS 0.514444f
+#define KPH_TO_MPS (1.0f / 3.6f)
+
+typedef enum ParserState {
+  WAIT_START,
+  BODY,
+  CHECKSUM_HIGH,
+  CHECKSUM_LOW
+} ParserState;
+
+/**
+ * One comma-separated field, accumulated a character at a time.
+ */
+typedef struct NmeaField {
+  uint64_t mantissa;
+  uint8_t digits;
+  uint8_t decimals;
+  bool hasDot;
+  bool isNegative;
+  char letter;
+} NmeaField;
+
+typedef struct NmeaParser {
+  ParserState state;
+  uint8_t length;
+  uint8_t checksum;
+  uint8_t expected;
+  uint8_t sentence;
+  uint8_t fieldIndex;
+  uint32_t tag; // last three characters of the address field
+  NmeaField field;
+  GpsData pending; // the fix with this sentence's fields applied, committed once the checksum matches
+} NmeaParser;
+
+static UART_HandleTypeDef *huart;
+static uint8_t *dmaBuffer;
+static uint16_t dmaSize;
+static uint16_t readPosition;
+static float timeSinceValid;
+
+static NmeaParser parser;
+static GpsData gpsData;
+
+static CanOutbox gpsFrame1;
+static CanOutbox gpsFrame2;
+static CanOutbox gpsFrame3;
+
+/*private functions =====================================================*/
+
+/**
+ * Field value as an integer with the given number of decimal places.
+ */
+static uint64_t gps_scaled(const NmeaField *field, uint8_t decimals) {
+  uint64_t value = field->mantissa;
+  for (uint8_t i = field->decimals; i < decimals; i++) {
+    value *= 10;
+  }
+  for (uint8_t i = decimals; i < field->decimals; i++) {
+    value /= 10;
+  }
+  return value;
+}
+
+static float gps_toFloat(const NmeaField *field) {
+  float value = (float) field->mantissa;
+  for (uint8_t i = 0; i < field->decimals; i++) {
+    value *= 0.1f;
+  }
+  return field->isNegative ? -value : value;
+}
+
+/**
+ * Convert (d)ddmm.mmmmm into 1e-7 degrees without going through floating point.
+ */
+static int32_t gps_toDegrees(const NmeaField *field) {
+  uint64_t total = gps_scaled(field, 5);
+  uint64_t degrees = total / 10000000;
+  uint64_t minutes = total % 10000000; // 1e-5 minutes
+  return (int32_t) (degrees * 10000000 + minutes * 5 / 3);
+}
+
+static void gps_applyTime(GpsData *data, const NmeaField *field) {
+  uint32_t time = (uint32_t) gps_scaled(field, 3); // hhmmss.sss
+  data->millis = time % 1000;
+  data->second = (time / 1000) % 100;
+  data->minute = (time / 100000) % 100;
+  data->hour = (time / 10000000) % 100;
+}
+
+static void gps_applyDate(GpsData *data, const NmeaField *field) {
+  uint32_t date = (uint32_t) gps_scaled(field, 0); // ddmmyy
+  data->day = date / 10000;
+  data->month = (date / 100) % 100;
+  data->year = date % 100;
+}
+
+static void gps_applyRmc(GpsData *data, uint8_t index, const NmeaField *field) {
+  switch (index) {
+    case 1: gps_applyTime(data, field); break;
+    case 2: data->isValid = field->letter == 'A'; break;
+    case 3: data->latitude = gps_toDegrees(field); break;
+    case 4: if (field->letter == 'S') data->latitude = -data->latitude; break;
+    case 5: data->longitude = gps_toDegrees(field); break;
+    case 6: if (field->letter == 'W') data->longitude = -data->longitude; break;
+    case 7: data->speed = gps_toFloat(field) * KNOTS_TO_MPS; break;
+    case 8: data->heading = gps_toFloat(field); break;
+    case 9: gps_applyDate(data, field); break;
+    default: break;
+  }
+}
+
+static void gps_applyGga(GpsData *data, uint8_t index, const NmeaField *field) {
+  switch (index) {
+    case 1: gps_applyTime(data, field); break;
+    case 2: data->latitude = gps_toDegrees(field); break;
+    case 3: if (field->letter == 'S') data->latitude = -data->latitude; break;
+    case 4: data->longitude = gps_toDegrees(field); break;
+    case 5: if (field->letter == 'W') data->longitude = -data->longitude; break;
+    case 6: data->fixQuality = (uint8_t) field->mantissa; break;
+    case 7: data->satellites = (uint8_t) field->mantissa; break;
+    case 9: data->altitude = gps_toFloat(field); break;
+    default: break;
+  }
+}
+
+static void gps_applyVtg(GpsData *data, uint8_t index, const NmeaField *field) {
+  switch (index) {
+    case 1: data->heading = gps_toFloat(field); break;
+    case 7: data->speed = gps_toFloat(field) * KPH_TO_MPS; break;
+    default: break;
+  }
+}
+
+/**
+ * A field ended with ',' or '*'. Empty fields leave the fix unchanged.
+ */
+static void gps_endField() {
+  const NmeaField *field = &parser.field;
+  if (parser.fieldIndex == 0) {
+    switch (parser.tag) {
+      case TAG('R', 'M', 'C'): parser.sentence = SENTENCE_RMC; break;
+      case TAG('G', 'G', 'A'): parser.sentence = SENTENCE_GGA; break;
+      case TAG('V', 'T', 'G'): parser.sentence = SENTENCE_VTG; break;
+      default: parser.sentence = SENTENCE_OTHER; break;
+    }
+  } else if (field->digits != 0 || field->letter != 0) {
+    switch (parser.sentence) {
+      case SENTENCE_RMC: gps_applyRmc(&parser.pending, parser.fieldIndex, field); break;
+      case SENTENCE_GGA: gps_applyGga(&parser.pending, parser.fieldIndex, field); break;
+      case SENTENCE_VTG: gps_applyVtg(&parser.pending, parser.fieldIndex, field); break;
+      default: break;
+    }
+  }
+  parser.fieldIndex++;
+  parser.field = NmeaField();
+}
+
+static void gps_fieldCharacter(char c) {
+  NmeaField *field = &parser.field;
+  if (parser.fieldIndex == 0) {
+    parser.tag = ((parser.tag << 8) | (uint8_t) c) & 0xFFFFFF;
+  } else if (c >= '0' && c <= '9') {
+    if (field->digits < 18) { // more digits than fit are extra decimals, drop them
+      field->mantissa = field->mantissa * 10 + (c - '0');
+      field->digits++;
+      if (field->hasDot) {
+        field->decimals++;
+      }
+    }
+  } else if (c == '.') {
+    field->hasDot = true;
+  } else if (c == '-') {
+    field->isNegative = true;
+  } else {
+    field->letter = c;
+  }
+}
+
+static int8_t gps_hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static void gps_updateOutboxes() {
+  gpsFrame1.dlc = 8;
+  can_writeInt(int32_t, &gpsFrame1, 0, gpsData.latitude);
+  can_writeInt(int32_t, &gpsFrame1, 4, gpsData.longitude);
+
+  gpsFrame2.dlc = 8;
+  can_writeFloat(uint16_t, &gpsFrame2, 0, gpsData.speed, 0.01f);
+  can_writeFloat(uint16_t, &gpsFrame2, 2, gpsData.heading, 0.01f);
+  can_writeInt(uint8_t, &gpsFrame2, 4, gpsData.hour);
+  can_writeInt(uint8_t, &gpsFrame2, 5, gpsData.minute);
+  can_writeInt(uint8_t, &gpsFrame2, 6, gpsData.second);
+  can_writeInt(uint8_t, &gpsFrame2, 7, gpsData.year);
+
+  gpsFrame3.dlc = 8;
+  can_writeInt(uint8_t, &gpsFrame3, 0, gpsData.month);
+  can_writeInt(uint8_t, &gpsFrame3, 1, gpsData.day);
+  can_writeInt(uint16_t, &gpsFrame3, 2, gpsData.millis);
+  can_writeInt(uint8_t, &gpsFrame3, 4, gpsData.fixQuality);
+  can_writeInt(uint8_t, &gpsFrame3, 5, gpsData.satellites);
+  can_writeFloat(int16_t, &gpsFrame3, 6, gpsData.altitude, 0.1f);
+}
+
+static void gps_badSentence() {
+  FAULT_SET(&faultVector, FAULT_VCU_GPS_BAD_RX);
+  parser.state = WAIT_START;
+}
+
+static bool gps_startDma() {
+  readPosition = 0;
+  if (HAL_UART_Receive_DMA(huart, dmaBuffer, dmaSize) != HAL_OK) {
+    FAULT_SET(&faultVector, FAULT_VCU_GPS_NO_DMA_START);
+    return false;
+  }
+  FAULT_CLEAR(&faultVector, FAULT_VCU_GPS_NO_DMA_START);
+  return true;
+}
+
+/*public functions =======================================================*/
+
+uint32_t gps_parse(const uint8_t *data, uint16_t length) {
+  uint32_t sentences = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    char c = (char) data[i];
+
+    if (c == '$') {
+      parser.state = BODY;
+      parser.length = 1;
+      parser.checksum = 0;
+      parser.fieldIndex = 0;
+      parser.tag = 0;
+      parser.field = NmeaField();
+      parser.pending = gpsData;
+      continue;
+    }
+    if (parser.state == WAIT_START) {
+      continue;
+    }
+    if (++parser.length > GPS_MAX_SENTENCE) {
+      gps_badSentence();
+      continue;
+    }
+
+    switch (parser.state) {
+      case BODY:
+        if (c == '*') {
+          gps_endField();
+          parser.state = CHECKSUM_HIGH;
+        } else if (c == '\r' || c == '\n') {
+          gps_badSentence(); // no checksum
+        } else {
+          parser.checksum ^= (uint8_t) c;
+          if (c == ',') {
+            gps_endField();
+          } else {
+            gps_fieldCharacter(c);
+          }
+        }
+        break;
+      case CHECKSUM_HIGH:
+        if (gps_hexValue(c) < 0) {
+          gps_badSentence();
+        } else {
+          parser.expected = gps_hexValue(c) << 4;
+          parser.state = CHECKSUM_LOW;
+        }
+        break;
+      case CHECKSUM_LOW:
+        if (gps_hexValue(c) < 0 || (parser.expected | gps_hexValue(c)) != parser.checksum) {
+          gps_badSentence();
+          break;
+        }
+        parser.state = WAIT_START;
+        gpsData = parser.pending;
+        timeSinceValid = 0;
+        FAULT_CLEAR(&faultVector, FAULT_VCU_GPS_BAD_RX);
+        FAULT_CLEAR(&faultVector, FAULT_VCU_GPS_TIMEOUT);
+        if (parser.sentence != SENTENCE_OTHER) {
+          gps_updateOutboxes();
+        }
+        sentences++;
+        break;
+      default:
+        break;
+    }
+  }
+  return sentences;
+}
+
+void gps_init(UART_HandleTypeDef *huart_ptr, uint8_t *buffer, uint16_t size, float period) {
+  huart = huart_ptr;
+  dmaBuffer = buffer;
+  dmaSize = size;
+  timeSinceValid = 0;
+  parser.state = WAIT_START;
+
+  can_addOutbox(GPS_FRAME_1, period, &gpsFrame1);
+  can_addOutbox(GPS_FRAME_2, period, &gpsFrame2);
+  can_addOutbox(GPS_FRAME_3, period, &gpsFrame3);
+  gps_startDma();
+}
+
+void gps_periodic(float deltaTime) {
+  timeSinceValid += deltaTime;
+  if (timeSinceValid > GPS_TIMEOUT) {
+    FAULT_SET(&faultVector, FAULT_VCU_GPS_TIMEOUT);
+    HAL_UART_DMAStop(huart);
+    parser.state = WAIT_START;
+    timeSinceValid = 0;
+    gps_startDma();
+    return;
+  }
+
+  // the DMA counter counts down the bytes left until it wraps around
+  uint16_t writePosition = dmaSize - (uint16_t) __HAL_DMA_GET_COUNTER(huart->hdmarx);
+  if (writePosition >= dmaSize) {
+    writePosition = 0;
+  }
+  if (writePosition < readPosition) {
+    gps_parse(dmaBuffer + readPosition, dmaSize - readPosition);
+    readPosition = 0;
+  }
+  gps_parse(dmaBuffer + readPosition, writePosition - readPosition);
+  readPosition = writePosition;
+}
+
+const GpsData *gps_getData() {
+  return &gpsData;
+}
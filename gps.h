@@ -0,0 +1,63 @@
+#ifndef LONGHORN_LIBRARY_2024_GPS_H
+#define LONGHORN_LIBRARY_2024_GPS_H
+
+#include <stdint.h>
+#include "main.h"
+
+#define GPS_TIMEOUT 1.0f // seconds without a valid sentence before the DMA is restarted
+#define GPS_MAX_SENTENCE 82 // longest NMEA sentence including '$' and "\r\n"
+
+/**
+ * Latest fix, assembled from RMC, GGA and VTG sentences.
+ */
+typedef struct GpsData {
+  int32_t latitude = 0; // 1e-7 degrees, north positive
+  int32_t longitude = 0; // 1e-7 degrees, east positive
+  float speed = 0; // m/s
+  float heading = 0; // degrees from true north
+  float altitude = 0; // m above mean sea level
+  uint8_t fixQuality = 0; // GGA fix quality, 0 = no fix
+  uint8_t satellites = 0;
+  bool isValid = false; // RMC status is active
+  uint8_t hour = 0;
+  uint8_t minute = 0;
+  uint8_t second = 0;
+  uint16_t millis = 0;
+  uint8_t day = 0;
+  uint8_t month = 0;
+  uint8_t year = 0; // since 2000
+} GpsData;
+
+/**
+ * Start receiving NMEA sentences into a circular DMA buffer and add the GPS_FRAME_1..3 outboxes.
+ * The UART RX DMA must be configured in circular mode, and on the H7 the buffer must be in DMA-accessible,
+ * non-cacheable memory.
+ * @param huart UART the GPS is connected to
+ * @param buffer DMA buffer, at least two sentences long
+ * @param size Size of the buffer
+ * @param period Period of the GPS outboxes in seconds
+ */
+void gps_init(UART_HandleTypeDef *huart, uint8_t *buffer, uint16_t size, float period);
+
+/**
+ * Parse everything the DMA wrote since the last call and update the fix, the GPS outboxes and the GPS fault bits.
+ * Restarts the DMA if no valid sentence arrived for GPS_TIMEOUT seconds.
+ * @param deltaTime how much time in seconds has passed since last function call
+ */
+void gps_periodic(float deltaTime);
+
+/**
+ * Parse NMEA characters. gps_periodic feeds the DMA buffer through this; it is public so recorded streams
+ * can be replayed.
+ * @param data Characters to parse
+ * @param length Number of characters
+ * @return Number of valid sentences completed
+ */
+uint32_t gps_parse(const uint8_t *data, uint16_t length);
+
+/**
+ * @return The latest fix
+ */
+const GpsData *gps_getData();
+
+#endif //LONGHORN_LIBRARY_2024_GPS_H
@@ -0,0 +1,145 @@
+#ifndef LONGHORN_LIBRARY_2024_HOST_FDCAN_H
+#define LONGHORN_LIBRARY_2024_HOST_FDCAN_H
+
+#include "main.h"
+
+#define FDCAN_STANDARD_ID 0x00000000U
+#define FDCAN_EXTENDED_ID 0x40000000U
+#define FDCAN_DATA_FRAME 0x00000000U
+#define FDCAN_ESI_ACTIVE 0x00000000U
+#define FDCAN_BRS_OFF 0x00000000U
+#define FDCAN_CLASSIC_CAN 0x00000000U
+#define FDCAN_NO_TX_EVENTS 0x00000000U
+#define FDCAN_STORE_TX_EVENTS 0x00800000U
+
+#define FDCAN_DLC_BYTES_0 0x00000000U
+#define FDCAN_DLC_BYTES_1 0x00000001U
+#define FDCAN_DLC_BYTES_2 0x00000002U
+#define FDCAN_DLC_BYTES_3 0x00000003U
+#define FDCAN_DLC_BYTES_4 0x00000004U
+#define FDCAN_DLC_BYTES_5 0x00000005U
+#define FDCAN_DLC_BYTES_6 0x00000006U
+#define FDCAN_DLC_BYTES_7 0x00000007U
+#define FDCAN_DLC_BYTES_8 0x00000008U
+
+#define FDCAN_RX_FIFO0 0x00000040U
+#define FDCAN_RX_FIFO1 0x00000041U
+
+#define FDCAN_FILTER_RANGE 0x00000000U
+#define FDCAN_FILTER_TO_RXFIFO0 0x00000001U
+#define FDCAN_FILTER_TO_RXFIFO1 0x00000002U
+#define FDCAN_ACCEPT_IN_RX_FIFO0 0x00000000U
+#define FDCAN_ACCEPT_IN_RX_FIFO1 0x00000001U
+#define FDCAN_REJECT 0x00000002U
+#define FDCAN_FILTER_REMOTE 0x00000000U
+#define FDCAN_REJECT_REMOTE 0x00000001U
+
+#define FDCAN_IT_RX_FIFO1_NEW_MESSAGE 0x00000010U
+#define FDCAN_IT_TX_EVT_FIFO_NEW_DATA 0x00001000U
+
+#define FDCAN_TIMESTAMP_INTERNAL 0x00000001U
+#define FDCAN_TIMESTAMP_PRESC_1 0x00000000U
+
+#define HAL_FDCAN_ERROR_NONE 0x00000000U
+#define HAL_FDCAN_ERROR_TIMEOUT 0x00000001U
+#define HAL_FDCAN_ERROR_NOT_INITIALIZED 0x00000002U
+#define HAL_FDCAN_ERROR_NOT_READY 0x00000004U
+#define HAL_FDCAN_ERROR_NOT_STARTED 0x00000008U
+#define HAL_FDCAN_ERROR_NOT_SUPPORTED 0x00000010U
+#define HAL_FDCAN_ERROR_PARAM 0x00000020U
+#define HAL_FDCAN_ERROR_PENDING 0x00000040U
+#define HAL_FDCAN_ERROR_RAM_ACCESS 0x00000080U
+#define HAL_FDCAN_ERROR_FIFO_EMPTY 0x00000100U
+#define HAL_FDCAN_ERROR_FIFO_FULL 0x00000200U
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t TxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t TxEventFifoControl;
+  uint32_t MessageMarker;
+} FDCAN_TxHeaderTypeDef;
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t RxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t RxTimestamp;
+  uint32_t FilterIndex;
+  uint32_t IsFilterMatchingFrame;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct {
+  uint32_t Identifier;
+  uint32_t IdType;
+  uint32_t TxFrameType;
+  uint32_t DataLength;
+  uint32_t ErrorStateIndicator;
+  uint32_t BitRateSwitch;
+  uint32_t FDFormat;
+  uint32_t TxTimestamp;
+  uint32_t MessageMarker;
+  uint32_t EventType;
+} FDCAN_TxEventFifoTypeDef;
+
+typedef struct {
+  uint32_t IdType;
+  uint32_t FilterIndex;
+  uint32_t FilterType;
+  uint32_t FilterConfig;
+  uint32_t FilterID1;
+  uint32_t FilterID2;
+  uint32_t RxBufferIndex;
+  uint32_t IsCalibrationMsg;
+} FDCAN_FilterTypeDef;
+
+typedef struct {
+  uint32_t StdFiltersNbr;
+  uint32_t ExtFiltersNbr;
+  uint32_t RxFifo0ElmtsNbr;
+  uint32_t RxFifo1ElmtsNbr;
+  uint32_t TxFifoQueueElmtsNbr;
+} FDCAN_InitTypeDef; // message RAM layout only
+
+typedef struct FDCAN_HandleTypeDef {
+  uint32_t Instance;
+  FDCAN_InitTypeDef Init;
+  volatile uint32_t ErrorCode;
+} FDCAN_HandleTypeDef;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxHeaderTypeDef *pTxHeader,
+                                                uint8_t *pTxData);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef *pRxHeader, uint8_t *pRxData);
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxEventFifoTypeDef *pTxEvent);
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *hfdcan);
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *hfdcan, const FDCAN_FilterTypeDef *sFilterConfig);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan, uint32_t NonMatchingStd,
+                                               uint32_t NonMatchingExt, uint32_t RejectRemoteStd,
+                                               uint32_t RejectRemoteExt);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *hfdcan, uint32_t ActiveITs,
+                                                 uint32_t BufferIndexes);
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef *hfdcan, uint32_t TimestampPrescaler);
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef *hfdcan, uint32_t TimestampOperation);
+uint16_t HAL_FDCAN_GetTimestampCounter(const FDCAN_HandleTypeDef *hfdcan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LONGHORN_LIBRARY_2024_HOST_FDCAN_H
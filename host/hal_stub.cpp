@@ -0,0 +1,650 @@
+#include "host_hal.h"
+
+#include <chrono>
+#include <string.h>
+
+#define HOST_MAX_CONTROLLERS 16
+#define HOST_MAX_UARTS 4
+#define HOST_MAX_FILTERS 32
+#define HOST_REJECT (-1)
+
+typedef struct HostRxFifo {
+  HostCanFrame frames[HOST_CAN_RX_FIFO_DEPTH];
+  uint16_t timestamps[HOST_CAN_RX_FIFO_DEPTH];
+  uint32_t head;
+  uint32_t count;
+} HostRxFifo;
+
+typedef struct HostTxEvent {
+  uint32_t id;
+  uint32_t marker;
+  uint16_t timestamp;
+} HostTxEvent;
+
+/**
+ * One acceptance filter: an inclusive ID range (FDCAN) or an ID and mask over the bxCAN
+ * 32-bit filter register layout (bxCAN).
+ */
+typedef struct HostFilter {
+  bool active;
+  uint32_t first;
+  uint32_t second;
+  int32_t fifo; // HOST_CAN_RX_FIFO0/1 or HOST_REJECT
+} HostFilter;
+
+typedef struct HostCan {
+  const HostCanHandle *handle;
+  HostCanHandle *peer;
+  HostRxFifo rx[2];
+  HostFilter filters[HOST_MAX_FILTERS];
+  bool filtered; // a filter has been configured
+  int32_t nonMatching; // where frames that match no filter go
+  HostCanFrame tx[HOST_CAN_TX_FIFO_DEPTH];
+  uint32_t txMarkers[HOST_CAN_TX_FIFO_DEPTH];
+  bool txEvents[HOST_CAN_TX_FIFO_DEPTH];
+  uint32_t txHead;
+  uint32_t txPending;
+  bool manualTx;
+  HostTxEvent events[HOST_CAN_TX_FIFO_DEPTH];
+  uint32_t eventHead;
+  uint32_t eventCount;
+  HostCanFrame log[HOST_CAN_TX_LOG_DEPTH];
+  uint32_t logHead;
+  uint32_t logCount;
+  bool logging;
+  uint32_t txCount;
+  uint16_t timestamp;
+} HostCan;
+
+typedef struct HostUart {
+  const UART_HandleTypeDef *handle;
+  uint8_t *buffer;
+  uint16_t size;
+  uint16_t position;
+} HostUart;
+
+SysTick_Type hostSysTick;
+CoreDebug_Type hostCoreDebug;
+GPIO_TypeDef hostGpioA;
+TIM_TypeDef hostTim2;
+TIM_TypeDef hostTim5;
+TIM_HandleTypeDef htim2 = {&hostTim2};
+TIM_HandleTypeDef htim5 = {&hostTim5};
+
+static DWT_Type hostDwt;
+static HostCan controllers[HOST_MAX_CONTROLLERS];
+static HostUart uarts[HOST_MAX_UARTS];
+static uint8_t spiRegisters[128];
+static uint8_t spiAddress = 0;
+static uint32_t tick = 0;
+
+static HostCan *host_getCan(const HostCanHandle *handle) {
+  for(HostCan &can : controllers) {
+    if(can.handle == handle) {
+      return &can;
+    }
+  }
+  for(HostCan &can : controllers) {
+    if(can.handle == nullptr) {
+      can = {};
+      can.handle = handle;
+      can.nonMatching = HOST_CAN_RX_FIFO0;
+      return &can;
+    }
+  }
+  return nullptr;
+}
+
+static HostUart *host_getUart(const UART_HandleTypeDef *huart) {
+  for(HostUart &uart : uarts) {
+    if(uart.handle == huart) {
+      return &uart;
+    }
+  }
+  for(HostUart &uart : uarts) {
+    if(uart.handle == nullptr) {
+      uart.handle = huart;
+      return &uart;
+    }
+  }
+  return nullptr;
+}
+
+static uint32_t host_pushRx(HostCan *can, uint32_t fifo, const HostCanFrame *frame) {
+  HostRxFifo *rx = &can->rx[fifo & 1];
+  uint32_t depth = HOST_CAN_RX_FIFO_DEPTH;
+#ifndef STM32L431xx
+  uint32_t elements = (fifo & 1) ? can->handle->Init.RxFifo1ElmtsNbr : can->handle->Init.RxFifo0ElmtsNbr;
+  depth = (elements < depth) ? elements : depth;
+#endif
+  if(rx->count >= depth) {
+    return 1;
+  }
+  uint32_t slot = (rx->head + rx->count) % HOST_CAN_RX_FIFO_DEPTH;
+  rx->frames[slot] = *frame;
+  rx->timestamps[slot] = can->timestamp;
+  rx->count++;
+  return 0;
+}
+
+static uint32_t host_popRx(HostCan *can, uint32_t fifo, HostCanFrame *frame, uint16_t *timestamp) {
+  HostRxFifo *rx = &can->rx[fifo & 1];
+  if(rx->count == 0) {
+    return 1;
+  }
+  *frame = rx->frames[rx->head];
+  *timestamp = rx->timestamps[rx->head];
+  rx->head = (rx->head + 1) % HOST_CAN_RX_FIFO_DEPTH;
+  rx->count--;
+  return 0;
+}
+
+/**
+ * Pick the FIFO for a received standard ID the way the controller's acceptance filtering would.
+ */
+static int32_t host_route(const HostCan *can, uint32_t id) {
+#ifdef STM32L431xx
+  if(!can->filtered) {
+    return HOST_CAN_RX_FIFO0;
+  }
+  uint32_t frameRegister = id << 21; // STID[10:0] in bits 31:21, IDE and RTR clear
+  for(const HostFilter &filter : can->filters) {
+    if(filter.active && (frameRegister & filter.second) == (filter.first & filter.second)) {
+      return filter.fifo;
+    }
+  }
+  return HOST_REJECT;
+#else
+  for(const HostFilter &filter : can->filters) {
+    if(filter.active && id >= filter.first && id <= filter.second) {
+      return filter.fifo;
+    }
+  }
+  return can->nonMatching;
+#endif
+}
+
+static int32_t host_deliver(HostCan *can, const HostCanFrame *frame) {
+  int32_t fifo = host_route(can, frame->id);
+  if(fifo == HOST_REJECT || host_pushRx(can, fifo, frame) != 0) {
+    return HOST_REJECT;
+  }
+  return fifo;
+}
+
+/**
+ * Put a frame on the wire: count and log it, record its TX event and hand it to the peer.
+ */
+static void host_transmit(HostCan *can, const HostCanFrame *frame, bool storeEvent, uint32_t marker) {
+  can->txCount++;
+
+  if(can->logging) {
+    uint32_t slot = (can->logHead + can->logCount) % HOST_CAN_TX_LOG_DEPTH;
+    can->log[slot] = *frame;
+    if(can->logCount < HOST_CAN_TX_LOG_DEPTH) {
+      can->logCount++;
+    } else {
+      can->logHead = (can->logHead + 1) % HOST_CAN_TX_LOG_DEPTH;
+    }
+  }
+
+  if(storeEvent && can->eventCount < HOST_CAN_TX_FIFO_DEPTH) {
+    uint32_t slot = (can->eventHead + can->eventCount) % HOST_CAN_TX_FIFO_DEPTH;
+    can->events[slot] = {frame->id, marker, can->timestamp};
+    can->eventCount++;
+  }
+
+  HostCan *peer = can->peer ? host_getCan(can->peer) : nullptr;
+  if(peer) {
+    host_deliver(peer, frame);
+  }
+}
+
+/**
+ * Queue a frame for transmission.
+ * @return 0 if it was queued or sent, 1 if the TX FIFO is full
+ */
+static uint32_t host_queueTx(HostCan *can, const HostCanFrame *frame, bool storeEvent, uint32_t marker) {
+  if(!can->manualTx) {
+    host_transmit(can, frame, storeEvent, marker);
+    return 0;
+  }
+  if(can->txPending >= HOST_CAN_TX_FIFO_DEPTH) {
+    return 1;
+  }
+  uint32_t slot = (can->txHead + can->txPending) % HOST_CAN_TX_FIFO_DEPTH;
+  can->tx[slot] = *frame;
+  can->txEvents[slot] = storeEvent;
+  can->txMarkers[slot] = marker;
+  can->txPending++;
+  return 0;
+}
+
+/* simulation controls ================================================== */
+
+void host_canReset(HostCanHandle *handle) {
+  HostCan *can = host_getCan(handle);
+  if(can) {
+    *can = {};
+    can->handle = handle;
+    can->nonMatching = HOST_CAN_RX_FIFO0;
+  }
+#ifndef STM32L431xx
+  // message RAM as CubeMX would lay it out for the simulated FIFOs
+  handle->Init.StdFiltersNbr = HOST_MAX_FILTERS;
+  handle->Init.ExtFiltersNbr = 0;
+  handle->Init.RxFifo0ElmtsNbr = HOST_CAN_RX_FIFO_DEPTH;
+  handle->Init.RxFifo1ElmtsNbr = HOST_CAN_RX_FIFO_DEPTH;
+  handle->Init.TxFifoQueueElmtsNbr = HOST_CAN_TX_FIFO_DEPTH;
+#endif
+}
+
+void host_canConnect(HostCanHandle *from, HostCanHandle *to) {
+  HostCan *can = host_getCan(from);
+  if(can) {
+    can->peer = to;
+  }
+}
+
+int32_t host_canReceive(HostCanHandle *handle, uint32_t id, uint8_t dlc, const uint8_t *data) {
+  HostCan *can = host_getCan(handle);
+  if(!can || dlc > 8) {
+    return HOST_REJECT;
+  }
+  HostCanFrame frame = {id, dlc, {}};
+  memcpy(frame.data, data, dlc);
+  return host_deliver(can, &frame);
+}
+
+uint32_t host_canInject(HostCanHandle *handle, uint32_t fifo, uint32_t id, uint8_t dlc, const uint8_t *data) {
+  HostCan *can = host_getCan(handle);
+  if(!can || dlc > 8) {
+    return 1;
+  }
+  HostCanFrame frame = {id, dlc, {}};
+  memcpy(frame.data, data, dlc);
+  return host_pushRx(can, fifo, &frame);
+}
+
+uint32_t host_canGetTxCount(HostCanHandle *handle) {
+  HostCan *can = host_getCan(handle);
+  return can ? can->txCount : 0;
+}
+
+void host_canSetManualTx(HostCanHandle *handle, bool manual) {
+  HostCan *can = host_getCan(handle);
+  if(can) {
+    host_canFlushTx(handle, HOST_CAN_TX_FIFO_DEPTH);
+    can->manualTx = manual;
+  }
+}
+
+uint32_t host_canFlushTx(HostCanHandle *handle, uint32_t maxFrames) {
+  HostCan *can = host_getCan(handle);
+  if(!can) {
+    return 0;
+  }
+  uint32_t sent = 0;
+  while(can->txPending > 0 && sent < maxFrames) {
+    host_transmit(can, &can->tx[can->txHead], can->txEvents[can->txHead], can->txMarkers[can->txHead]);
+    can->txHead = (can->txHead + 1) % HOST_CAN_TX_FIFO_DEPTH;
+    can->txPending--;
+    sent++;
+  }
+  return sent;
+}
+
+void host_canSetTxLogging(HostCanHandle *handle, bool enable) {
+  HostCan *can = host_getCan(handle);
+  if(can) {
+    can->logging = enable;
+  }
+}
+
+uint32_t host_canPopTx(HostCanHandle *handle, HostCanFrame *frame) {
+  HostCan *can = host_getCan(handle);
+  if(!can || can->logCount == 0) {
+    return 1;
+  }
+  *frame = can->log[can->logHead];
+  can->logHead = (can->logHead + 1) % HOST_CAN_TX_LOG_DEPTH;
+  can->logCount--;
+  return 0;
+}
+
+void host_canSetTimestamp(HostCanHandle *handle, uint16_t ticks) {
+  HostCan *can = host_getCan(handle);
+  if(can) {
+    can->timestamp = ticks;
+  }
+}
+
+void host_setTick(uint32_t value) {
+  tick = value;
+}
+
+void host_spiSetRegisters(uint8_t address, const uint8_t *values, uint8_t size) {
+  for(uint8_t i = 0; i < size; i++) {
+    spiRegisters[(address + i) & 0x7F] = values[i];
+  }
+}
+
+void host_uartReceive(UART_HandleTypeDef *huart, const uint8_t *data, uint32_t length) {
+  HostUart *uart = host_getUart(huart);
+  if(!uart || !uart->buffer) {
+    return;
+  }
+  for(uint32_t i = 0; i < length; i++) {
+    uart->buffer[uart->position] = data[i];
+    uart->position = (uart->position + 1) % uart->size;
+  }
+  huart->hdmarx->NDTR = uart->size - uart->position;
+}
+
+/* CMSIS / HAL ========================================================== */
+
+DWT_Type *host_dwt(void) {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  hostDwt.CYCCNT = (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  return &hostDwt;
+}
+
+uint32_t HAL_GetTick(void) {
+  return tick;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+  return 280000000;
+}
+
+uint32_t HAL_SYSTICK_Config(uint32_t TicksNumb) {
+  hostSysTick.LOAD = TicksNumb - 1;
+  hostSysTick.VAL = 0;
+  return 0;
+}
+
+void HAL_SYSTICK_CLKSourceConfig(uint32_t CLKSource) {
+  hostSysTick.CTRL |= CLKSource;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t) {
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type) {
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+  if(PinState == GPIO_PIN_SET) {
+    GPIOx->ODR |= GPIO_Pin;
+  } else {
+    GPIOx->ODR &= ~(uint32_t) GPIO_Pin;
+  }
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *, const uint8_t *pData, uint16_t Size, uint32_t) {
+  if(Size == 0) {
+    return HAL_ERROR;
+  }
+  if(Size == 1) {
+    spiAddress = pData[0] & 0x7F;
+  } else {
+    host_spiSetRegisters(pData[0] & 0x7F, pData + 1, Size - 1);
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *, uint8_t *pData, uint16_t Size, uint32_t) {
+  for(uint16_t i = 0; i < Size; i++) {
+    pData[i] = spiRegisters[(spiAddress + i) & 0x7F];
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+  HostUart *uart = host_getUart(huart);
+  if(!uart || !huart->hdmarx || Size == 0) {
+    return HAL_ERROR;
+  }
+  uart->buffer = pData;
+  uart->size = Size;
+  uart->position = 0;
+  huart->hdmarx->NDTR = Size;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) {
+  HostUart *uart = host_getUart(huart);
+  if(uart) {
+    uart->buffer = nullptr;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *, uint32_t) {
+  return HAL_OK;
+}
+
+void Error_Handler(void) {
+}
+
+#ifdef STM32L431xx
+
+/* bxCAN ================================================================ */
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan) {
+  return host_getCan(hcan) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[],
+                                       uint32_t *pTxMailbox) {
+  HostCan *can = host_getCan(hcan);
+  if(!can || pHeader->DLC > 8) {
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+    return HAL_ERROR;
+  }
+  uint32_t id = (pHeader->IDE == CAN_ID_EXT) ? pHeader->ExtId : pHeader->StdId;
+  HostCanFrame frame = {id, (uint8_t) pHeader->DLC, {}};
+  memcpy(frame.data, aData, frame.dlc);
+  if(host_queueTx(can, &frame, false, 0) != 0) {
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM; // what the HAL reports when no mailbox is free
+    return HAL_ERROR;
+  }
+  *pTxMailbox = CAN_TX_MAILBOX0 << (can->txPending % HOST_CAN_TX_FIFO_DEPTH);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan, uint32_t) {
+  HostCan *can = host_getCan(hcan);
+  if(can) {
+    can->txPending = 0;
+  }
+  return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef *hcan) {
+  HostCan *can = host_getCan(hcan);
+  return can ? HOST_CAN_TX_FIFO_DEPTH - can->txPending : 0;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader,
+                                       uint8_t aData[]) {
+  HostCan *can = host_getCan(hcan);
+  HostCanFrame frame;
+  uint16_t timestamp;
+  if(!can || host_popRx(can, RxFifo, &frame, &timestamp) != 0) {
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+    return HAL_ERROR;
+  }
+  *pHeader = {};
+  if(frame.id > 0x7FF) {
+    pHeader->ExtId = frame.id;
+    pHeader->IDE = CAN_ID_EXT;
+  } else {
+    pHeader->StdId = frame.id;
+    pHeader->IDE = CAN_ID_STD;
+  }
+  pHeader->RTR = CAN_RTR_DATA;
+  pHeader->DLC = frame.dlc;
+  pHeader->Timestamp = timestamp;
+  memcpy(aData, frame.data, frame.dlc);
+  return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef *hcan, uint32_t RxFifo) {
+  HostCan *can = host_getCan(hcan);
+  return can ? can->rx[RxFifo & 1].count : 0;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, const CAN_FilterTypeDef *sFilterConfig) {
+  HostCan *can = host_getCan(hcan);
+  if(!can || sFilterConfig->FilterBank >= CAN_FILTER_BANKS ||
+     sFilterConfig->FilterMode != CAN_FILTERMODE_IDMASK || sFilterConfig->FilterScale != CAN_FILTERSCALE_32BIT) {
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+    return HAL_ERROR;
+  }
+  HostFilter &filter = can->filters[sFilterConfig->FilterBank];
+  filter.active = sFilterConfig->FilterActivation == CAN_FILTER_ENABLE;
+  filter.first = (sFilterConfig->FilterIdHigh << 16) | sFilterConfig->FilterIdLow;
+  filter.second = (sFilterConfig->FilterMaskIdHigh << 16) | sFilterConfig->FilterMaskIdLow;
+  filter.fifo = (sFilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO1) ? HOST_CAN_RX_FIFO1 : HOST_CAN_RX_FIFO0;
+  can->filtered = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *, uint32_t) {
+  return HAL_OK;
+}
+
+#else
+
+/* FDCAN ================================================================ */
+
+static uint32_t host_fdcanFifo(uint32_t location) {
+  return (location == FDCAN_RX_FIFO1) ? HOST_CAN_RX_FIFO1 : HOST_CAN_RX_FIFO0;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *hfdcan) {
+  return host_getCan(hfdcan) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef *) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxHeaderTypeDef *pTxHeader,
+                                                uint8_t *pTxData) {
+  HostCan *can = host_getCan(hfdcan);
+  if(!can || pTxHeader->DataLength > FDCAN_DLC_BYTES_8) {
+    hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+    return HAL_ERROR;
+  }
+
+  HostCanFrame frame = {pTxHeader->Identifier, (uint8_t) pTxHeader->DataLength, {}};
+  memcpy(frame.data, pTxData, frame.dlc);
+  bool storeEvent = pTxHeader->TxEventFifoControl == FDCAN_STORE_TX_EVENTS;
+  if(host_queueTx(can, &frame, storeEvent, pTxHeader->MessageMarker) != 0) {
+    hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_FULL;
+    return HAL_ERROR;
+  }
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef *pRxHeader, uint8_t *pRxData) {
+  HostCan *can = host_getCan(hfdcan);
+  HostCanFrame frame;
+  uint16_t timestamp;
+  if(!can || host_popRx(can, host_fdcanFifo(RxLocation), &frame, &timestamp) != 0) {
+    hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+    return HAL_ERROR;
+  }
+
+  *pRxHeader = {};
+  pRxHeader->Identifier = frame.id;
+  pRxHeader->IdType = (frame.id > 0x7FF) ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+  pRxHeader->RxFrameType = FDCAN_DATA_FRAME;
+  pRxHeader->DataLength = frame.dlc;
+  pRxHeader->FDFormat = FDCAN_CLASSIC_CAN;
+  pRxHeader->RxTimestamp = timestamp;
+  memcpy(pRxData, frame.data, frame.dlc);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef *hfdcan, FDCAN_TxEventFifoTypeDef *pTxEvent) {
+  HostCan *can = host_getCan(hfdcan);
+  if(!can || can->eventCount == 0) {
+    hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+    return HAL_ERROR;
+  }
+
+  const HostTxEvent &event = can->events[can->eventHead];
+  *pTxEvent = {};
+  pTxEvent->Identifier = event.id;
+  pTxEvent->IdType = FDCAN_STANDARD_ID;
+  pTxEvent->TxTimestamp = event.timestamp;
+  pTxEvent->MessageMarker = event.marker;
+
+  can->eventHead = (can->eventHead + 1) % HOST_CAN_TX_FIFO_DEPTH;
+  can->eventCount--;
+  return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *hfdcan) {
+  HostCan *can = host_getCan(hfdcan);
+  return can ? HOST_CAN_TX_FIFO_DEPTH - can->txPending : 0;
+}
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo) {
+  HostCan *can = host_getCan(hfdcan);
+  return can ? can->rx[host_fdcanFifo(RxFifo)].count : 0;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *hfdcan, const FDCAN_FilterTypeDef *sFilterConfig) {
+  HostCan *can = host_getCan(hfdcan);
+  if(!can || sFilterConfig->IdType != FDCAN_STANDARD_ID || sFilterConfig->FilterIndex >= HOST_MAX_FILTERS ||
+     sFilterConfig->FilterIndex >= hfdcan->Init.StdFiltersNbr || sFilterConfig->FilterType != FDCAN_FILTER_RANGE) {
+    hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+    return HAL_ERROR;
+  }
+  HostFilter &filter = can->filters[sFilterConfig->FilterIndex];
+  filter.active = true;
+  filter.first = sFilterConfig->FilterID1;
+  filter.second = sFilterConfig->FilterID2;
+  filter.fifo = (sFilterConfig->FilterConfig == FDCAN_FILTER_TO_RXFIFO1) ? HOST_CAN_RX_FIFO1 : HOST_CAN_RX_FIFO0;
+  can->filtered = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *hfdcan, uint32_t NonMatchingStd, uint32_t,
+                                               uint32_t, uint32_t) {
+  HostCan *can = host_getCan(hfdcan);
+  if(!can) {
+    return HAL_ERROR;
+  }
+  can->nonMatching = (NonMatchingStd == FDCAN_REJECT) ? HOST_REJECT
+                   : (NonMatchingStd == FDCAN_ACCEPT_IN_RX_FIFO1) ? HOST_CAN_RX_FIFO1 : HOST_CAN_RX_FIFO0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *, uint32_t, uint32_t) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef *, uint32_t) {
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef *, uint32_t) {
+  return HAL_OK;
+}
+
+uint16_t HAL_FDCAN_GetTimestampCounter(const FDCAN_HandleTypeDef *hfdcan) {
+  HostCan *can = host_getCan(hfdcan);
+  return can ? can->timestamp : 0;
+}
+
+#endif
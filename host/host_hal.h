@@ -0,0 +1,140 @@
+#ifndef LONGHORN_LIBRARY_2024_HOST_HAL_H
+#define LONGHORN_LIBRARY_2024_HOST_HAL_H
+
+#include "main.h"
+#include "tim.h"
+
+#ifdef STM32L431xx
+#include "can.h"
+typedef CAN_HandleTypeDef HostCanHandle;
+#define HOST_CAN_TX_FIFO_DEPTH 3 // TX mailboxes
+#else
+#include "fdcan.h"
+typedef FDCAN_HandleTypeDef HostCanHandle;
+#define HOST_CAN_TX_FIFO_DEPTH 32
+#endif
+
+/**
+ * Controls for the simulated peripherals behind the host stand-in HAL.
+ *
+ * Each CAN handle (FDCAN on H7 builds, bxCAN on L431 builds) gets a simulated controller: frames queued for
+ * transmission go on the wire (are counted, optionally logged, and received by a connected handle) either
+ * straight away or, in manual mode, when host_canFlushTx says the bus had time for them.
+ * Received frames are routed to RX FIFO 0 or 1 by the filters the library configured, like the hardware:
+ * FDCAN standard filters in index order, then the global filter; bxCAN mask filters in bank order. Until a
+ * bxCAN filter is configured every frame goes to FIFO 0, so tests don't need a board filter setup.
+ * The simulated RX FIFOs are HOST_CAN_RX_FIFO_DEPTH deep on both families (bxCAN hardware has 3).
+ * The timestamp counter, tick and SPI register file are set by hand.
+ */
+
+#define HOST_CAN_RX_FIFO_DEPTH 64
+#define HOST_CAN_TX_LOG_DEPTH 1024
+#define HOST_CAN_RX_FIFO0 0
+#define HOST_CAN_RX_FIFO1 1
+
+typedef struct HostCanFrame {
+  uint32_t id;
+  uint8_t dlc;
+  uint8_t data[8];
+} HostCanFrame;
+
+/**
+ * Return a simulated controller to its reset state (empty FIFOs, no filters, nothing logged, not connected).
+ * @param handle Handle of the controller
+ */
+void host_canReset(HostCanHandle *handle);
+
+/**
+ * Deliver every frame transmitted on one handle to another (one direction), through the receiver's filters.
+ * @param from Transmitting handle
+ * @param to Receiving handle, or nullptr to disconnect
+ */
+void host_canConnect(HostCanHandle *from, HostCanHandle *to);
+
+/**
+ * Receive a frame from the bus: it is routed to a FIFO, or dropped, by the configured filters.
+ * @param handle Handle of the controller
+ * @param id Standard ID
+ * @param dlc Data length in bytes
+ * @param data Payload
+ * @return FIFO the frame was stored in (HOST_CAN_RX_FIFO0/1), -1 if it was filtered out or the FIFO was full
+ */
+int32_t host_canReceive(HostCanHandle *handle, uint32_t id, uint8_t dlc, const uint8_t *data);
+
+/**
+ * Place a frame in an RX FIFO directly, bypassing the filters.
+ * @param handle Handle of the controller
+ * @param fifo HOST_CAN_RX_FIFO0 or HOST_CAN_RX_FIFO1
+ * @param id Standard ID, or extended ID if above 0x7FF
+ * @param dlc Data length in bytes
+ * @param data Payload
+ * @return 0 if successful, 1 if the FIFO was full (the frame is lost, like the hardware)
+ */
+uint32_t host_canInject(HostCanHandle *handle, uint32_t fifo, uint32_t id, uint8_t dlc, const uint8_t *data);
+
+/**
+ * @param handle Handle of the controller
+ * @return Number of frames put on the wire since the last reset
+ */
+uint32_t host_canGetTxCount(HostCanHandle *handle);
+
+/**
+ * Hold transmitted frames in the TX FIFO (mailboxes on bxCAN) until host_canFlushTx, so the free level and
+ * FIFO-full errors behave like a bus with limited bandwidth. Off by default (frames go on the wire when queued).
+ * @param handle Handle of the controller
+ * @param manual Whether to hold frames
+ */
+void host_canSetManualTx(HostCanHandle *handle, bool manual);
+
+/**
+ * Put the oldest held frames on the wire.
+ * @param handle Handle of the controller
+ * @param maxFrames Most frames the bus can carry this time
+ * @return Number of frames sent
+ */
+uint32_t host_canFlushTx(HostCanHandle *handle, uint32_t maxFrames);
+
+/**
+ * Keep the most recent HOST_CAN_TX_LOG_DEPTH transmitted frames for inspection (off by default).
+ * @param handle Handle of the controller
+ * @param enable Whether to log
+ */
+void host_canSetTxLogging(HostCanHandle *handle, bool enable);
+
+/**
+ * Take the oldest frame from the transmit log.
+ * @param handle Handle of the controller
+ * @param frame Output frame
+ * @return 0 if a frame was returned, 1 if the log is empty
+ */
+uint32_t host_canPopTx(HostCanHandle *handle, HostCanFrame *frame);
+
+/**
+ * Set the value the timestamp counter reads back (and stamps RX frames and TX events with).
+ * @param handle Handle of the controller
+ * @param ticks Counter value
+ */
+void host_canSetTimestamp(HostCanHandle *handle, uint16_t ticks);
+
+/**
+ * @param tick Value returned by HAL_GetTick
+ */
+void host_setTick(uint32_t tick);
+
+/**
+ * Load the register file the SPI stub answers reads from (register address = last byte transmitted & 0x7F).
+ * @param address First register to write
+ * @param values Register contents
+ * @param size Number of registers
+ */
+void host_spiSetRegisters(uint8_t address, const uint8_t *values, uint8_t size);
+
+/**
+ * Write bytes into a UART's circular DMA buffer as if they had been received.
+ * @param huart Handle started with HAL_UART_Receive_DMA
+ * @param data Bytes received
+ * @param length Number of bytes
+ */
+void host_uartReceive(UART_HandleTypeDef *huart, const uint8_t *data, uint32_t length);
+
+#endif //LONGHORN_LIBRARY_2024_HOST_HAL_H
@@ -0,0 +1,115 @@
+#ifndef LONGHORN_LIBRARY_2024_HOST_MAIN_H
+#define LONGHORN_LIBRARY_2024_HOST_MAIN_H
+
+/**
+ * Stand-in for the CubeMX main.h and the parts of the STM32 HAL and CMSIS the library uses,
+ * so the library can be built and benchmarked on a desktop. See host_hal.h for the simulation controls.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+  HAL_OK = 0x00U,
+  HAL_ERROR = 0x01U,
+  HAL_BUSY = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+  GPIO_PIN_RESET = 0U,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+  uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t LOAD;
+  volatile uint32_t VAL;
+  volatile uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+  volatile uint32_t LAR; // Cortex-M7 only
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef enum {
+  SysTick_IRQn = -1
+} IRQn_Type;
+
+// single-threaded host: no interrupts to mask
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void) priMask; }
+static inline void __disable_irq(void) {}
+
+#define SYSTICK_CLKSOURCE_HCLK 0x00000004U
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+DWT_Type *host_dwt(void);
+#ifdef __cplusplus
+}
+#endif
+
+extern SysTick_Type hostSysTick;
+extern CoreDebug_Type hostCoreDebug;
+#define SysTick (&hostSysTick)
+#define DWT (host_dwt()) // CYCCNT counts nanoseconds of host time
+#define CoreDebug (&hostCoreDebug)
+
+typedef struct {
+  uint32_t Instance;
+} SPI_HandleTypeDef;
+
+typedef struct {
+  volatile uint32_t NDTR;
+} DMA_HandleTypeDef;
+
+typedef struct {
+  DMA_HandleTypeDef *hdmarx;
+  uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+extern GPIO_TypeDef hostGpioA;
+#define SPI_CS_IMU_GPIO_Port (&hostGpioA)
+#define SPI_CS_IMU_Pin 0x0010U
+
+#define __HAL_DMA_GET_COUNTER(handle) ((handle)->NDTR)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t HAL_GetTick(void);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_SYSTICK_Config(uint32_t TicksNumb);
+void HAL_SYSTICK_CLKSourceConfig(uint32_t CLKSource);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart);
+
+void Error_Handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LONGHORN_LIBRARY_2024_HOST_MAIN_H
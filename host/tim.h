@@ -0,0 +1,38 @@
+#ifndef LONGHORN_LIBRARY_2024_HOST_TIM_H
+#define LONGHORN_LIBRARY_2024_HOST_TIM_H
+
+#include "main.h"
+
+typedef struct {
+  volatile uint32_t CCR1;
+  volatile uint32_t CCR2;
+  volatile uint32_t CCR3;
+} TIM_TypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+
+extern TIM_TypeDef hostTim2;
+extern TIM_TypeDef hostTim5;
+#define TIM2 (&hostTim2)
+#define TIM5 (&hostTim5)
+
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim5;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LONGHORN_LIBRARY_2024_HOST_TIM_H
@@ -0,0 +1,278 @@
+#include "isotp.h"
+
+#define PCI_SINGLE 0x0
+#define PCI_FIRST 0x1
+#define PCI_CONSECUTIVE 0x2
+#define PCI_FLOW_CONTROL 0x3
+
+#define FLOW_CONTINUE 0x0
+#define FLOW_WAIT 0x1
+#define FLOW_OVERFLOW 0x2
+
+#define PADDING 0xCC
+
+/**
+ * Convert an STmin byte into seconds. Reserved values mean the maximum, 127 ms.
+ */
+static float isotp_decodeStMin(uint8_t stMin) {
+  if (stMin <= 0x7F) {
+    return (float) stMin * 0.001f;
+  }
+  if (stMin >= 0xF1 && stMin <= 0xF9) {
+    return (float) (stMin - 0xF0) * 0.0001f;
+  }
+  return 0.127f;
+}
+
+/**
+ * Send one frame, padded to 8 bytes.
+ * @param pci First byte of the frame
+ * @param payload Bytes following the PCI byte
+ * @param length Number of payload bytes, at most 7
+ */
+static uint32_t isotp_sendFrame(IsoTpChannel *channel, uint8_t pci, const uint8_t *payload, uint8_t length) {
+  uint8_t frame[8];
+  frame[0] = pci;
+  for (uint8_t i = 0; i < 7; i++) {
+    frame[i + 1] = (i < length) ? payload[i] : PADDING;
+  }
+  return can_busSend(channel->bus, channel->txId, 8, frame);
+}
+
+static void isotp_sendFlowControl(IsoTpChannel *channel, uint8_t flowStatus) {
+  uint8_t parameters[2] = {channel->blockSize, channel->stMin};
+  isotp_sendFrame(channel, (PCI_FLOW_CONTROL << 4) | flowStatus, parameters, 2);
+}
+
+/**
+ * Send as many consecutive frames as the flow control and the TX FIFO allow.
+ * With a non-zero separation time at most one frame goes out per call.
+ */
+static void isotp_pump(IsoTpChannel *channel) {
+  while (channel->txState == ISOTP_TX_SENDING) {
+    if (channel->_txSeparation > 0 && channel->_txTimer < channel->_txSeparation) {
+      return;
+    }
+    if (can_busGetTxFreeLevel(channel->bus) == 0) {
+      return;
+    }
+
+    uint16_t remaining = channel->_txLength - channel->_txOffset;
+    uint8_t length = (remaining > 7) ? 7 : (uint8_t) remaining;
+    if (isotp_sendFrame(channel, (PCI_CONSECUTIVE << 4) | channel->_txSequence,
+                        channel->_txData + channel->_txOffset, length) != 0) {
+      return;
+    }
+    channel->_txOffset += length;
+    channel->_txSequence = (channel->_txSequence + 1) & 0xF;
+    channel->_txTimer = 0;
+
+    if (channel->_txOffset == channel->_txLength) {
+      channel->txState = ISOTP_TX_DONE;
+      return;
+    }
+    if (channel->_txBlockRemaining != 0 && --channel->_txBlockRemaining == 0) {
+      channel->txState = ISOTP_TX_WAIT_FLOW_CONTROL;
+      return;
+    }
+    if (channel->_txSeparation > 0) {
+      return;
+    }
+  }
+}
+
+static void isotp_onFlowControl(IsoTpChannel *channel, const uint8_t *data) {
+  if (channel->txState != ISOTP_TX_WAIT_FLOW_CONTROL) {
+    return;
+  }
+  switch (data[0] & 0xF) {
+    case FLOW_CONTINUE:
+      channel->_txBlockRemaining = data[1];
+      channel->_txSeparation = isotp_decodeStMin(data[2]);
+      channel->_txTimer = channel->_txSeparation;
+      channel->txState = ISOTP_TX_SENDING;
+      isotp_pump(channel);
+      break;
+    case FLOW_WAIT:
+      channel->_txTimer = 0;
+      break;
+    default:
+      channel->txState = ISOTP_TX_ERROR;
+      break;
+  }
+}
+
+static void isotp_onSingleFrame(IsoTpChannel *channel, const uint8_t *data, uint8_t dlc) {
+  uint8_t length = data[0] & 0xF;
+  if (channel->rxState != ISOTP_RX_ARMED || length == 0 || length >= dlc || length > channel->_rxCapacity) {
+    return;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    channel->_rxBuffer[i] = data[i + 1];
+  }
+  channel->_rxLength = length;
+  channel->rxState = ISOTP_RX_DONE;
+}
+
+static void isotp_onFirstFrame(IsoTpChannel *channel, const uint8_t *data, uint8_t dlc) {
+  if (channel->rxState != ISOTP_RX_ARMED && channel->rxState != ISOTP_RX_RECEIVING) {
+    // no buffer to receive into: tell the sender now instead of letting it time out waiting for flow control
+    isotp_sendFlowControl(channel, FLOW_OVERFLOW);
+    return;
+  }
+  uint16_t length = ((data[0] & 0xF) << 8) | data[1];
+  if (dlc < 8 || length <= 7 || length > channel->_rxCapacity) {
+    isotp_sendFlowControl(channel, FLOW_OVERFLOW);
+    channel->rxState = ISOTP_RX_ARMED;
+    return;
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+    channel->_rxBuffer[i] = data[i + 2];
+  }
+  channel->_rxLength = length;
+  channel->_rxOffset = 6;
+  channel->_rxSequence = 1;
+  channel->_rxBlockCount = 0;
+  channel->_rxTimer = 0;
+  channel->rxState = ISOTP_RX_RECEIVING;
+  isotp_sendFlowControl(channel, FLOW_CONTINUE);
+}
+
+static void isotp_onConsecutiveFrame(IsoTpChannel *channel, const uint8_t *data, uint8_t dlc) {
+  if (channel->rxState != ISOTP_RX_RECEIVING) {
+    return;
+  }
+  if ((data[0] & 0xF) != channel->_rxSequence) {
+    channel->rxState = ISOTP_RX_ERROR;
+    return;
+  }
+
+  uint16_t remaining = channel->_rxLength - channel->_rxOffset;
+  uint8_t length = (remaining > 7) ? 7 : (uint8_t) remaining;
+  if (length >= dlc) {
+    length = dlc - 1;
+  }
+  uint8_t *destination = channel->_rxBuffer + channel->_rxOffset;
+  for (uint8_t i = 0; i < length; i++) {
+    destination[i] = data[i + 1];
+  }
+  channel->_rxOffset += length;
+  channel->_rxSequence = (channel->_rxSequence + 1) & 0xF;
+  channel->_rxTimer = 0;
+
+  if (channel->_rxOffset == channel->_rxLength) {
+    channel->rxState = ISOTP_RX_DONE;
+  } else if (channel->blockSize != 0 && ++channel->_rxBlockCount == channel->blockSize) {
+    channel->_rxBlockCount = 0;
+    isotp_sendFlowControl(channel, FLOW_CONTINUE);
+  }
+}
+
+/**
+ * Inbox handler, runs from the RX path for every frame on the channel's rxId.
+ */
+static void isotp_onFrame(CanInbox *inbox, void *context) {
+  IsoTpChannel *channel = static_cast<IsoTpChannel *>(context);
+  const uint8_t *data = inbox->data;
+  uint8_t dlc = inbox->dlc;
+  if (dlc == 0) {
+    return;
+  }
+
+  switch (data[0] >> 4) {
+    case PCI_SINGLE:
+      isotp_onSingleFrame(channel, data, dlc);
+      break;
+    case PCI_FIRST:
+      isotp_onFirstFrame(channel, data, dlc);
+      break;
+    case PCI_CONSECUTIVE:
+      isotp_onConsecutiveFrame(channel, data, dlc);
+      break;
+    case PCI_FLOW_CONTROL:
+      if (dlc >= 3) {
+        isotp_onFlowControl(channel, data);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+uint32_t isotp_init(IsoTpChannel *channel, CanBus *bus, uint32_t txId, uint32_t rxId,
+                    uint8_t blockSize, uint8_t stMin) {
+  if (can_busIsImmediate(bus, rxId)) {
+    return 1; // the handler sends flow control, which is not allowed from the RX interrupt
+  }
+  channel->bus = bus;
+  channel->txId = txId;
+  channel->rxId = rxId;
+  channel->blockSize = blockSize;
+  channel->stMin = stMin;
+  can_busAddInbox(bus, rxId, &channel->_inbox);
+  return can_setInboxHandler(&channel->_inbox, isotp_onFrame, channel);
+}
+
+uint32_t isotp_send(IsoTpChannel *channel, const uint8_t *data, uint16_t length) {
+  if (channel->txState == ISOTP_TX_WAIT_FLOW_CONTROL || channel->txState == ISOTP_TX_SENDING) {
+    return 1;
+  }
+  if (length == 0 || length > ISOTP_MAX_LENGTH) {
+    return 1;
+  }
+
+  if (length <= 7) {
+    if (isotp_sendFrame(channel, (PCI_SINGLE << 4) | length, data, length) != 0) {
+      return 1;
+    }
+    channel->txState = ISOTP_TX_DONE;
+    return 0;
+  }
+
+  uint8_t header[7] = {(uint8_t) (length & 0xFF)};
+  for (uint8_t i = 0; i < 6; i++) {
+    header[i + 1] = data[i];
+  }
+  if (isotp_sendFrame(channel, (PCI_FIRST << 4) | (length >> 8), header, 7) != 0) {
+    return 1;
+  }
+  channel->_txData = data;
+  channel->_txLength = length;
+  channel->_txOffset = 6;
+  channel->_txSequence = 1;
+  channel->_txTimer = 0;
+  channel->txState = ISOTP_TX_WAIT_FLOW_CONTROL;
+  return 0;
+}
+
+uint32_t isotp_receive(IsoTpChannel *channel, uint8_t *buffer, uint16_t capacity) {
+  if (channel->rxState == ISOTP_RX_RECEIVING) {
+    return 1;
+  }
+  channel->_rxBuffer = buffer;
+  channel->_rxCapacity = capacity;
+  channel->_rxLength = 0;
+  channel->rxState = ISOTP_RX_ARMED;
+  return 0;
+}
+
+uint16_t isotp_getRxLength(const IsoTpChannel *channel) {
+  return channel->_rxLength;
+}
+
+void isotp_periodic(IsoTpChannel *channel, float deltaTime) {
+  if (channel->txState == ISOTP_TX_WAIT_FLOW_CONTROL || channel->txState == ISOTP_TX_SENDING) {
+    channel->_txTimer += deltaTime;
+  }
+  if (channel->txState == ISOTP_TX_WAIT_FLOW_CONTROL && channel->_txTimer > channel->timeout) {
+    channel->txState = ISOTP_TX_ERROR;
+  }
+  isotp_pump(channel);
+
+  if (channel->rxState == ISOTP_RX_RECEIVING) {
+    channel->_rxTimer += deltaTime;
+    if (channel->_rxTimer > channel->timeout) {
+      channel->rxState = ISOTP_RX_ERROR;
+    }
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef LONGHORN_LIBRARY_2024_ISOTP_H
+#define LONGHORN_LIBRARY_2024_ISOTP_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+#define ISOTP_MAX_LENGTH 4095
+#define ISOTP_DEFAULT_TIMEOUT 1.0f // seconds, used for both N_Bs and N_Cr
+
+typedef enum IsoTpTxState {
+  ISOTP_TX_IDLE,
+  ISOTP_TX_WAIT_FLOW_CONTROL,
+  ISOTP_TX_SENDING,
+  ISOTP_TX_DONE,
+  ISOTP_TX_ERROR
+} IsoTpTxState;
+
+typedef enum IsoTpRxState {
+  ISOTP_RX_IDLE, // no buffer given, first frames are answered with an overflow flow control
+  ISOTP_RX_ARMED,
+  ISOTP_RX_RECEIVING,
+  ISOTP_RX_DONE,
+  ISOTP_RX_ERROR
+} IsoTpRxState;
+
+/**
+ * One ISO 15765-2 (ISO-TP) connection: a pair of CAN IDs that carries messages of up to 4095 bytes
+ * as single, first and consecutive frames, paced by flow control frames from the receiver.\n
+ * Payload is copied straight between the CAN frames and the caller's buffers, so those buffers must stay
+ * valid until the transfer is done.
+ */
+typedef struct IsoTpChannel {
+  CanBus *bus = nullptr;
+  uint32_t txId = 0;
+  uint32_t rxId = 0;
+  uint8_t blockSize = 0; // consecutive frames we accept per flow control, 0 = no limit
+  uint8_t stMin = 0; // raw STmin we ask the sender for (0x00-0x7F ms, 0xF1-0xF9 100-900 us)
+  float timeout = ISOTP_DEFAULT_TIMEOUT;
+  CanInbox _inbox;
+
+  IsoTpTxState txState = ISOTP_TX_IDLE;
+  const uint8_t *_txData = nullptr;
+  uint16_t _txLength = 0;
+  uint16_t _txOffset = 0;
+  uint8_t _txSequence = 0;
+  uint8_t _txBlockRemaining = 0; // 0 = no limit
+  float _txSeparation = 0;
+  float _txTimer = 0;
+
+  IsoTpRxState rxState = ISOTP_RX_IDLE;
+  uint8_t *_rxBuffer = nullptr;
+  uint16_t _rxCapacity = 0;
+  uint16_t _rxLength = 0;
+  uint16_t _rxOffset = 0;
+  uint8_t _rxSequence = 0;
+  uint8_t _rxBlockCount = 0;
+  float _rxTimer = 0;
+} IsoTpChannel;
+
+/**
+ * Set up a channel and register its inbox and RX handler on the bus.
+ * @param channel Channel to set up
+ * @param bus Bus the channel runs on
+ * @param txId ID of the frames we send (data and our flow control)
+ * @param rxId ID of the frames we receive (data and the peer's flow control)
+ * @param blockSize Consecutive frames the peer may send before waiting for our next flow control, 0 = no limit
+ * @param stMin Minimum separation we ask the peer for, as the raw ISO-TP STmin byte
+ * @return 0 if successful, 1 if rxId is in the immediate band of the bus or the inbox handler could not be registered
+ */
+uint32_t isotp_init(IsoTpChannel *channel, CanBus *bus, uint32_t txId, uint32_t rxId,
+                    uint8_t blockSize = 0, uint8_t stMin = 0);
+
+/**
+ * Start sending a message. The data is read from the given buffer while the transfer runs.
+ * @param channel Channel to send on
+ * @param data Message to send
+ * @param length Length of the message, 1 to ISOTP_MAX_LENGTH
+ * @return 0 if the transfer was started, 1 if a transfer is already running or the length is invalid
+ */
+uint32_t isotp_send(IsoTpChannel *channel, const uint8_t *data, uint16_t length);
+
+/**
+ * Accept the next incoming message into the given buffer.
+ * Messages longer than the capacity are refused with an overflow flow control frame.
+ * @param channel Channel to receive on
+ * @param buffer Where the message is written
+ * @param capacity Size of the buffer
+ * @return 0 if successful, 1 if a message is being received right now
+ */
+uint32_t isotp_receive(IsoTpChannel *channel, uint8_t *buffer, uint16_t capacity);
+
+/**
+ * @return Length of the received message once rxState is ISOTP_RX_DONE
+ */
+uint16_t isotp_getRxLength(const IsoTpChannel *channel);
+
+/**
+ * Send consecutive frames that are due and check for timeouts.
+ * Call after can_busPeriodic of the channel's bus.
+ * @param deltaTime how much time in seconds has passed since last function call
+ */
+void isotp_periodic(IsoTpChannel *channel, float deltaTime);
+
+#endif //LONGHORN_LIBRARY_2024_ISOTP_H
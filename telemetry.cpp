@@ -0,0 +1,276 @@
+#include "telemetry.h"
+#include "faults.h"
+#include <string.h>
+
+typedef struct TelemetryChannel {
+  uint8_t schemaId;
+  CanInbox *inbox;
+  float period;
+  float _timer;
+  uint32_t _sequence; // inbox sequence at the last sample
+} TelemetryChannel;
+
+typedef struct TelemetryBatch {
+  uint16_t length;
+  uint8_t data[TELEMETRY_BATCH_SIZE];
+} TelemetryBatch;
+
+static TelemetryChannel channels[TELEMETRY_MAX_CHANNELS];
+static uint8_t channelCount;
+
+// queued batches are queue[order[head]] .. queue[order[head + queueLength - 1]], positions modulo the depth;
+// the remaining positions hold the free slots, and the open batch is kept apart
+static TelemetryBatch queue[TELEMETRY_QUEUE_DEPTH];
+static uint8_t order[TELEMETRY_QUEUE_DEPTH];
+static uint8_t queueHead;
+static uint8_t queueLength;
+static bool isInFlight; // the oldest batch was handed out by telemetry_peekBatch and is being sent
+static TelemetryBatch openBatch;
+
+static TelemetryPolicy policy;
+static float flushPeriod;
+static float batchAge;
+static uint32_t uptime; // ms since telemetry_init
+static float timeRemainder;
+static uint32_t lastRecordTime;
+static uint16_t sequence;
+static TelemetryStats stats;
+
+static void telemetry_write16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xFF;
+  data[1] = value >> 8;
+}
+
+static void telemetry_write32(uint8_t *data, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    data[i] = (value >> (i * 8)) & 0xFF;
+  }
+}
+
+static void telemetry_openBatch() {
+  uint8_t *data = openBatch.data;
+  data[0] = TELEMETRY_MAGIC;
+  data[1] = TELEMETRY_VERSION;
+  telemetry_write16(data + 2, sequence);
+  telemetry_write32(data + 4, uptime);
+  data[8] = 0;
+  openBatch.length = TELEMETRY_HEADER_SIZE;
+  lastRecordTime = uptime;
+  batchAge = 0;
+}
+
+static uint8_t telemetry_position(uint8_t index) {
+  return (queueHead + index) % TELEMETRY_QUEUE_DEPTH;
+}
+
+/**
+ * Drop the oldest batch that is not being sent.
+ * @return false if the only queued batch is in flight
+ */
+static bool telemetry_dropOldest() {
+  if (!isInFlight) {
+    queueHead = telemetry_position(1);
+    queueLength--;
+    return true;
+  }
+  if (queueLength < 2) {
+    return false;
+  }
+  // close the gap behind the in-flight batch; the dropped slot becomes the first free one
+  uint8_t dropped = order[telemetry_position(1)];
+  for (uint8_t i = 1; i + 1 < queueLength; i++) {
+    order[telemetry_position(i)] = order[telemetry_position(i + 1)];
+  }
+  order[telemetry_position(queueLength - 1)] = dropped;
+  queueLength--;
+  return true;
+}
+
+/**
+ * Move the open batch into the queue, making room according to the policy.
+ */
+static void telemetry_queueBatch() {
+  if (openBatch.data[8] == 0) {
+    telemetry_openBatch(); // nothing recorded, just restart the clock
+    return;
+  }
+
+  if (queueLength == TELEMETRY_QUEUE_DEPTH) {
+    FAULT_SET(&faultVector, FAULT_VCU_CELL_QUEUE_FULL);
+    stats.droppedBatches++;
+    if (!telemetry_dropOldest()) {
+      sequence++; // the open batch is the one lost, the gap in sequence numbers still shows it
+      telemetry_openBatch();
+      return;
+    }
+  }
+  TelemetryBatch *slot = &queue[order[telemetry_position(queueLength)]];
+  slot->length = openBatch.length;
+  memcpy(slot->data, openBatch.data, openBatch.length);
+  queueLength++;
+  stats.batches++;
+  sequence++;
+
+  if (policy == TELEMETRY_DOWNSAMPLE) {
+    if (queueLength * 4 > TELEMETRY_QUEUE_DEPTH * 3 && stats.downsample < TELEMETRY_MAX_DOWNSAMPLE) {
+      stats.downsample++;
+    } else if (queueLength * 4 < TELEMETRY_QUEUE_DEPTH && stats.downsample > 0) {
+      stats.downsample--;
+    }
+  }
+  telemetry_openBatch();
+}
+
+/**
+ * Append one record to the open batch, queueing the batch first if the record does not fit.
+ */
+static void telemetry_record(const TelemetryChannel *channel) {
+  CanFrame frame;
+  can_readInbox(channel->inbox, &frame);
+
+  uint32_t delta = uptime - lastRecordTime;
+  uint8_t varint[5];
+  uint8_t varintLength = 0;
+  do {
+    varint[varintLength] = delta & 0x7F;
+    delta >>= 7;
+    if (delta != 0) {
+      varint[varintLength] |= 0x80;
+    }
+    varintLength++;
+  } while (delta != 0);
+
+  uint16_t recordLength = 2 + varintLength + frame.dlc;
+  if (openBatch.length + recordLength > TELEMETRY_BATCH_SIZE || openBatch.data[8] == UINT8_MAX) {
+    telemetry_queueBatch();
+    telemetry_record(channel); // the delta is now relative to the new header
+    return;
+  }
+
+  uint8_t *data = openBatch.data + openBatch.length;
+  data[0] = channel->schemaId;
+  data[1] = frame.dlc;
+  memcpy(data + 2, varint, varintLength);
+  memcpy(data + 2 + varintLength, frame.data, frame.dlc);
+  openBatch.length += recordLength;
+  openBatch.data[8]++;
+  lastRecordTime = uptime;
+  stats.records++;
+}
+
+void telemetry_init(TelemetryPolicy telemetryPolicy, float telemetryFlushPeriod) {
+  policy = telemetryPolicy;
+  flushPeriod = telemetryFlushPeriod;
+  channelCount = 0;
+  queueHead = 0;
+  queueLength = 0;
+  isInFlight = false;
+  for (uint8_t i = 0; i < TELEMETRY_QUEUE_DEPTH; i++) {
+    order[i] = i;
+  }
+  uptime = 0;
+  timeRemainder = 0;
+  sequence = 0;
+  stats = TelemetryStats();
+  telemetry_openBatch();
+  FAULT_CLEAR(&faultVector, FAULT_VCU_CELL_QUEUE_FULL);
+}
+
+uint32_t telemetry_addChannel(uint8_t schemaId, CanInbox *inbox, float period) {
+  if (channelCount == TELEMETRY_MAX_CHANNELS) {
+    return 1;
+  }
+  channels[channelCount++] = {schemaId, inbox, period, 0, can_getInboxSequence(inbox)};
+  return 0;
+}
+
+void telemetry_periodic(float deltaTime) {
+  timeRemainder += deltaTime * 1000.0f;
+  uint32_t elapsed = (uint32_t) timeRemainder;
+  uptime += elapsed;
+  timeRemainder -= (float) elapsed;
+
+  float stretch = (float) (1 << stats.downsample);
+  for (uint8_t i = 0; i < channelCount; i++) {
+    TelemetryChannel *channel = &channels[i];
+    channel->_timer += deltaTime;
+    float period = channel->period * stretch;
+    if (channel->_timer < period) {
+      continue;
+    }
+    channel->_timer -= period; // keep the remainder, or the rate drifts low
+    if (channel->_timer >= period) {
+      channel->_timer = 0; // we fell behind, do not try to catch up
+    }
+
+    uint32_t inboxSequence = can_getInboxSequence(channel->inbox);
+    if (inboxSequence != channel->_sequence) {
+      channel->_sequence = inboxSequence;
+      telemetry_record(channel);
+    }
+  }
+
+  batchAge += deltaTime;
+  if (batchAge >= flushPeriod) {
+    telemetry_queueBatch();
+  }
+}
+
+bool telemetry_peekBatch(const uint8_t **data, uint16_t *length) {
+  if (queueLength == 0) {
+    return false;
+  }
+  const TelemetryBatch *batch = &queue[order[queueHead]];
+  *data = batch->data;
+  *length = batch->length;
+  isInFlight = true;
+  return true;
+}
+
+void telemetry_popBatch() {
+  if (queueLength == 0) {
+    return;
+  }
+  queueHead = telemetry_position(1);
+  queueLength--;
+  isInFlight = false;
+  FAULT_CLEAR(&faultVector, FAULT_VCU_CELL_QUEUE_FULL);
+}
+
+uint16_t telemetry_formatSendCommand(char *buffer, uint16_t size, uint8_t connectId, uint16_t length) {
+  static const char prefix[] = "AT+QISEND=";
+  char digits[10];
+  uint8_t count = 0;
+
+  // digits are collected backwards: length, ',' then connectId
+  do {
+    digits[count++] = (char) ('0' + length % 10);
+    length /= 10;
+  } while (length != 0);
+  digits[count++] = ',';
+  do {
+    digits[count++] = (char) ('0' + connectId % 10);
+    connectId /= 10;
+  } while (connectId != 0);
+
+  uint16_t total = (sizeof(prefix) - 1) + count + 1; // + '\r'
+  if (total + 1 > size) {
+    return 0;
+  }
+  memcpy(buffer, prefix, sizeof(prefix) - 1);
+  char *out = buffer + sizeof(prefix) - 1;
+  while (count != 0) {
+    *out++ = digits[--count];
+  }
+  *out++ = '\r';
+  *out = '\0';
+  return total;
+}
+
+uint8_t telemetry_getQueueLength() {
+  return queueLength;
+}
+
+const TelemetryStats *telemetry_getStats() {
+  return &stats;
+}
@@ -0,0 +1,96 @@
+#ifndef LONGHORN_LIBRARY_2024_TELEMETRY_H
+#define LONGHORN_LIBRARY_2024_TELEMETRY_H
+
+#include <stdint.h>
+#include "angel_can.h"
+
+/**
+ * Batched telemetry for the cellular uplink.\n
+ * Selected inboxes are sampled at their own rates (only when they received a new frame) and serialised into
+ * batches that are handed to the modem driver one block at a time. Batches wait in a fixed-size queue, so RAM
+ * use is bounded; when the modem falls behind the queue either drops its oldest batch or samples less often.
+ * The batch being sent is never dropped: the next-oldest goes instead.\n
+ * Batch format, little endian:
+ * - header: magic 0xA5, version 1, sequence (u16), time of the batch in ms since telemetry_init (u32), record count (u8)
+ * - record: schema ID (u8), dlc (u8), time since the previous record (or the header) in ms as a LEB128 varint,
+ *   then dlc data bytes
+ */
+
+#ifndef TELEMETRY_BATCH_SIZE
+#define TELEMETRY_BATCH_SIZE 512
+#endif
+#ifndef TELEMETRY_QUEUE_DEPTH
+#define TELEMETRY_QUEUE_DEPTH 8
+#endif
+#define TELEMETRY_MAX_CHANNELS 32
+#define TELEMETRY_MAX_DOWNSAMPLE 3 // periods are stretched by up to 2^3
+#define TELEMETRY_MAGIC 0xA5
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 9
+
+typedef enum TelemetryPolicy {
+  TELEMETRY_DROP_OLDEST, // a full queue discards its oldest batch
+  TELEMETRY_DOWNSAMPLE // a filling queue doubles sample periods, and drops the oldest batch only when full
+} TelemetryPolicy;
+
+typedef struct TelemetryStats {
+  uint32_t records = 0;
+  uint32_t batches = 0;
+  uint32_t droppedBatches = 0;
+  uint8_t downsample = 0; // sample periods are currently multiplied by 2^downsample
+} TelemetryStats;
+
+/**
+ * Reset the telemetry queue and remove all channels.
+ * @param policy What to do when the modem cannot keep up
+ * @param flushPeriod Longest time in seconds a batch is held open before it is queued
+ */
+void telemetry_init(TelemetryPolicy policy, float flushPeriod);
+
+/**
+ * Sample an inbox into the uplink.
+ * @param schemaId Identifies the frame layout to the server
+ * @param inbox Inbox to sample
+ * @param period in seconds
+ * @return 0 if successful, 1 if there are already TELEMETRY_MAX_CHANNELS channels
+ */
+uint32_t telemetry_addChannel(uint8_t schemaId, CanInbox *inbox, float period);
+
+/**
+ * Sample the channels that are due and queue the open batch when it is full or old enough.
+ * @param deltaTime how much time in seconds has passed since last function call
+ */
+void telemetry_periodic(float deltaTime);
+
+/**
+ * Get the oldest queued batch without removing it. The batch is in flight from now on: it stays where it is,
+ * and is never dropped to make room, until telemetry_popBatch.
+ * @param data Set to the batch
+ * @param length Set to the batch length in bytes
+ * @return true if there is a batch
+ */
+bool telemetry_peekBatch(const uint8_t **data, uint16_t *length);
+
+/**
+ * Remove the oldest queued batch, once the modem has sent it.
+ */
+void telemetry_popBatch();
+
+/**
+ * Write the AT command that announces a payload block to the modem, e.g. "AT+QISEND=0,312\r".
+ * @param buffer Where the command is written, null terminated
+ * @param size Size of the buffer
+ * @param connectId Socket the payload is sent on
+ * @param length Length of the payload
+ * @return Length of the command, 0 if the buffer is too small
+ */
+uint16_t telemetry_formatSendCommand(char *buffer, uint16_t size, uint8_t connectId, uint16_t length);
+
+/**
+ * @return Number of queued batches
+ */
+uint8_t telemetry_getQueueLength();
+
+const TelemetryStats *telemetry_getStats();
+
+#endif //LONGHORN_LIBRARY_2024_TELEMETRY_H
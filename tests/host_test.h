@@ -0,0 +1,37 @@
+#ifndef LONGHORN_LIBRARY_2024_HOST_TEST_H
+#define LONGHORN_LIBRARY_2024_HOST_TEST_H
+
+#include <stdio.h>
+
+/**
+ * Minimal checks for the host tests in tests/, built against the stand-in HAL in host/.
+ * Every tests/test_*.cpp is its own executable, built once per target family and run by ctest.
+ * A test returns HOST_TEST_RESULT from main: 0 if every check passed, 1 otherwise. A test that only applies to
+ * one family returns HOST_TEST_SKIP on the other.
+ */
+
+#define HOST_TEST_SKIP 77
+
+static unsigned hostTestFailures = 0;
+
+#define CHECK(condition)                                                          \
+  do {                                                                            \
+    if (!(condition)) {                                                           \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      hostTestFailures++;                                                         \
+    }                                                                             \
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                               \
+  do {                                                                                        \
+    double difference_ = (double) (actual) - (double) (expected);                             \
+    if (difference_ > (tolerance) || difference_ < -(tolerance)) {                            \
+      fprintf(stderr, "%s:%d: check failed: %s = %g, expected %g\n", __FILE__, __LINE__, #actual, \
+              (double) (actual), (double) (expected));                                        \
+      hostTestFailures++;                                                                     \
+    }                                                                                         \
+  } while (0)
+
+#define HOST_TEST_RESULT (hostTestFailures == 0 ? 0 : 1)
+
+#endif //LONGHORN_LIBRARY_2024_HOST_TEST_H
@@ -0,0 +1,185 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_history.h"
+
+/**
+ * Slope and interpolation over an inbox history: frames that arrive between two can_busPeriodic calls are
+ * told apart by their hardware RX timestamp on the H7, and frames sharing one timestamp give a slope of 0
+ * instead of a division by zero. The bus time keeps its resolution after hours of uptime. Ages taken from one
+ * count stay put while frames are pushed, and frames too short for the value are never read past their dlc.
+ */
+
+#define TICK 1e-5f // 10 us per timestamp counter tick
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanInbox inbox;
+static CanHistory<16> history;
+
+static void test_receive(uint16_t value) {
+  uint8_t data[2] = {(uint8_t) value, (uint8_t) (value >> 8)};
+  CHECK(host_canReceive(&handle, HVC_VCU_PACK_STATUS, 2, data) >= 0);
+}
+
+static void test_reset() {
+  bus = CanBus();
+  inbox = CanInbox();
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  can_busAddInbox(&bus, HVC_VCU_PACK_STATUS, &inbox);
+  can_attachHistory(&inbox, &history);
+}
+
+/**
+ * Frames that share one time: no slope, and interpolation takes the newer value.
+ */
+static void test_sharedTime() {
+  test_reset();
+  CHECK(can_historySlope<uint16_t>(&history, 0, 1.0f, 8) == 0); // empty
+  test_receive(100);
+  test_receive(200);
+  test_receive(300);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(can_historySize(&history) == 3);
+  CHECK(can_historyGet(&history, 0)->rxTime == can_historyGet(&history, 2)->rxTime);
+  CHECK(can_historySlope<uint16_t>(&history, 0, 1.0f, 8) == 0);
+
+  float value = 0;
+  CHECK(can_historyInterpolate<uint16_t>(&history, 0, 1.0f, bus.time, &value));
+  CHECK_NEAR(value, 300, 1e-6);
+  CHECK(!can_historyInterpolate<uint16_t>(&history, 0, 1.0f, bus.time + 0.01f, &value));
+}
+
+/**
+ * A ramp received once per can_busPeriodic call, stamped with the bus time.
+ */
+static void test_busTime() {
+  test_reset();
+  for (uint16_t i = 0; i < 10; i++) {
+    test_receive(1000 + 50 * i); // 50 per 10 ms
+    can_busPeriodic(&bus, 0.01f);
+  }
+  CHECK_NEAR(can_historySlope<uint16_t>(&history, 0, 0.01f, 16), 50.0, 0.05);
+  CHECK_NEAR(can_historySlope<uint16_t>(&history, 0, 0.01f, 2), 50.0, 0.05);
+
+  float value = 0;
+  double newest = can_historyGet(&history, 0)->rxTime;
+  CHECK(can_historyInterpolate<uint16_t>(&history, 0, 0.01f, newest - 0.025f, &value));
+  CHECK_NEAR(value, 13.25, 0.001); // 14.5 at the newest frame, 0.5 per 10 ms
+}
+
+#ifdef H7_SERIES
+/**
+ * A ramp received in bursts of 5 frames, 1 ms apart, between can_busPeriodic calls 10 ms apart.
+ */
+static void test_hardwareTime() {
+  test_reset();
+  CHECK(can_busSetTimestampPeriod(&bus, TICK) == 0);
+  uint16_t counter = 65000; // wraps during the test
+  host_canSetTimestamp(&handle, counter);
+  can_busPeriodic(&bus, 0.01f);
+  for (uint16_t burst = 0; burst < 3; burst++) {
+    for (uint16_t i = 0; i < 5; i++) {
+      counter += 100;
+      host_canSetTimestamp(&handle, counter);
+      test_receive(2000 + 3 * (burst * 5 + i)); // 3 per ms
+    }
+    counter += 500;
+    host_canSetTimestamp(&handle, counter);
+    can_busPeriodic(&bus, 0.01f);
+  }
+  CHECK(can_historySize(&history) == 15);
+  CHECK_NEAR(can_historyGet(&history, 0)->rxTime - can_historyGet(&history, 1)->rxTime, 0.001, 1e-5);
+  CHECK_NEAR(bus.time - can_historyGet(&history, 0)->rxTime, 0.005, 1e-5);
+  CHECK_NEAR(inbox.rxTime, can_historyGet(&history, 0)->rxTime, 1e-6);
+  CHECK_NEAR(can_historySlope<uint16_t>(&history, 0, 1.0f, 5), 3000.0, 1.0);
+
+  // halfway between the two newest frames
+  float value = 0;
+  double newest = can_historyGet(&history, 0)->rxTime;
+  CHECK(can_historyInterpolate<uint16_t>(&history, 0, 1.0f, newest - 0.0005f, &value));
+  CHECK_NEAR(value, 2040.5, 0.01);
+
+  // frames the interrupt takes after the reference was sampled are stamped after the bus time
+  counter += 200;
+  host_canSetTimestamp(&handle, counter);
+  test_receive(5000);
+  can_busPeriodic(&bus, 0.0f);
+  CHECK_NEAR(can_historyGet(&history, 0)->rxTime, bus.time, 1e-5);
+
+  // back to the bus time
+  CHECK(can_busSetTimestampPeriod(&bus, 0) == 0);
+  test_receive(6000);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(can_historyGet(&history, 0)->rxTime == bus.time);
+}
+#endif
+
+/**
+ * 1 ms ticks after ten hours of uptime still move the bus time and tell frames apart.
+ */
+static void test_longUptime() {
+  test_reset();
+  for (uint32_t i = 0; i < 10 * 3600; i++) {
+    can_busPeriodic(&bus, 1.0f);
+  }
+  CHECK_NEAR(bus.time, 36000.0, 1e-6);
+  for (uint16_t i = 0; i < 10; i++) {
+    test_receive(1000 + 5 * i); // 5 per ms
+    can_busPeriodic(&bus, 0.001f);
+  }
+  CHECK_NEAR(bus.time, 36000.01, 1e-6);
+  CHECK_NEAR(can_historyGet(&history, 0)->rxTime - can_historyGet(&history, 1)->rxTime, 0.001, 1e-6);
+  CHECK_NEAR(can_historySlope<uint16_t>(&history, 0, 1.0f, 10), 5000.0, 1.0);
+}
+
+/**
+ * A push between two reads does not move the frames seen through one count, and short frames end the data.
+ */
+static void test_countAndLength() {
+  test_reset();
+  for (uint16_t i = 0; i < 4; i++) {
+    test_receive(100 * (i + 1));
+    can_busPeriodic(&bus, 0.01f);
+  }
+  uint32_t pushed = can_historyCount(&history);
+  const CanHistoryEntry *newest = can_historyAt(&history, pushed, 0);
+  test_receive(900); // as if from the RX interrupt in the middle of a calculation
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(can_historyAt(&history, pushed, 0) == newest && newest->data[0] == (uint8_t) 400);
+  CHECK(can_historyGet(&history, 0) != newest);
+  CHECK(can_historyAt(&history, pushed, 4) == nullptr);
+
+  // a 1 byte frame cannot hold a uint16_t at byte 0, or anything at byte 1
+  uint8_t shortFrame[1] = {7};
+  CHECK(host_canReceive(&handle, HVC_VCU_PACK_STATUS, 1, shortFrame) >= 0);
+  can_busPeriodic(&bus, 0.01f);
+  float values[8];
+  CHECK(can_historyLatest<uint16_t>(&history, 0, 1.0f, values, 8) == 0);
+  CHECK(can_historyLatest<uint8_t>(&history, 0, 1.0f, values, 8) == 6 && values[0] == 7);
+  CHECK(can_historyLatest<uint8_t>(&history, 1, 1.0f, values, 8) == 0);
+  CHECK(can_historySlope<uint16_t>(&history, 0, 1.0f, 8) == 0);
+  float value = 0;
+  CHECK(!can_historyInterpolate<uint16_t>(&history, 0, 1.0f, bus.time - 0.005, &value));
+  CHECK(can_historyInterpolate<uint16_t>(&history, 0, 1.0f, bus.time - 0.015, &value));
+  CHECK_NEAR(value, 650, 1e-3); // halfway between 400 and 900
+
+  // once the short frame is not the newest, only the frames after it are read
+  test_receive(1000);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(can_historyLatest<uint16_t>(&history, 0, 1.0f, values, 8) == 1 && values[0] == 1000);
+}
+
+int main() {
+  test_countAndLength();
+  test_sharedTime();
+  test_busTime();
+  test_longUptime();
+#ifdef H7_SERIES
+  test_hardwareTime();
+#else
+  test_reset();
+  CHECK(can_busSetTimestampPeriod(&bus, TICK) == 1);
+#endif
+  return HOST_TEST_RESULT;
+}
@@ -0,0 +1,105 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_planner.h"
+
+/**
+ * Plan the periodic traffic of every board on the car's bus, as assigned in angel_can_ids.h, and hold the
+ * result to the budget of a 1 Mbit/s bus with a 1 ms tick: every slot must be on the wire before the next tick.
+ * Update the table when IDs or periods change; a failure here means the bus schedule no longer fits.
+ */
+
+#define TEST_TICK 0.001f
+#define TEST_BITRATE 1000000
+#define TEST_MAX_PEAK_FRAMES 6 // a tick carries about 7 worst-case 8 byte frames at 1 Mbit/s
+#define TEST_MAX_QUEUE_DELAY TEST_TICK
+
+typedef struct TestOutboxRange {
+  uint32_t idLow;
+  uint32_t idHigh;
+  float period;
+} TestOutboxRange;
+
+static const TestOutboxRange outboxRanges[] = {
+    // inverter broadcast and commands
+    {INV_TEMP1_DATA, INV_TEMP1_DATA, 0.1f},
+    {INV_TEMP3_DATA, INV_TEMP3_DATA, 0.1f},
+    {INV_MOTOR_POSITIONS, INV_VOLTAGE, 0.01f},
+    {INV_STATE_CODES, INV_TORQUE_TIMER, 0.01f},
+    {INV_HIGH_SPEED_MSG, INV_HIGH_SPEED_MSG, 0.003f},
+    {VCU_INV_COMMAND, VCU_INV_COMMAND, 0.003f},
+    // VCU
+    {VCU_PDU_BRAKELIGHT, VCU_HVC_ALLOW_BALANCE, 0.1f},
+    {VCU_DASH_INFO1, VCU_DASH_INFO2, 0.1f},
+    // HVC
+    {HVC_VCU_AMS_IMD, HVC_VCU_AMS_IMD, 0.05f},
+    {HVC_VCU_PACK_STATUS, HVC_VCU_CCS_INFO, 0.01f},
+    {HVC_VCU_FAN_RPM, HVC_VCU_FAN_RPM, 0.1f},
+    {HVC_DSH_FAULT_MSG, HVC_DSH_FAULT_MSG, 0.1f},
+    {HVC_VCU_CELL_VOLTAGES_START, HVC_VCU_CELL_VOLTAGES_END, 0.1f},
+    {HVC_VCU_CONTACTOR_STATUS, HVC_VCU_CONTACTOR_STATUS, 0.05f},
+    {HVC_VCU_CELL_TEMPS_START, HVC_VCU_CELL_TEMPS_END, 0.1f},
+    // PDU (PDU_VCU_STATUS shares its ID with PDU_VCU_LV_CURRENTS_2)
+    {PDU_VCU_THERMAL, PDU_VCU_IMU_GYRO, 0.01f},
+    {PDU_DSH_FAULT_MSG, PDU_DSH_FAULT_MSG, 0.1f},
+    {PDU_VCU_LVBAT, PDU_VCU_LV_CURRENTS_2, 0.1f},
+    // unsprung modules
+    {UNSFR_VCU_MAGNET, UNSFR_VCU_IMU, 0.005f},
+    {UNSFR_DSH_FAULT_MSG, UNSFR_DSH_FAULT_MSG, 0.1f},
+    {UNSFL_VCU_MAGNET, UNSFL_VCU_IMU, 0.005f},
+    {UNSFL_DSH_FAULT_MSG, UNSFL_DSH_FAULT_MSG, 0.1f},
+    {UNSBR_VCU_MAGNET, UNSBR_VCU_IMU, 0.005f},
+    {UNSBR_DSH_FAULT_MSG, UNSBR_DSH_FAULT_MSG, 0.1f},
+    {UNSBL_VCU_MAGNET, UNSBL_VCU_IMU, 0.005f},
+    {UNSBL_DSH_FAULT_MSG_, UNSBL_DSH_FAULT_MSG_, 0.1f},
+    // GPS and dash
+    {GPS_FRAME_1, GPS_FRAME_3, 0.1f},
+    {DSH_FAULT_MSG, DSH_FAULT_MSG, 0.1f},
+    {DSH_VCU_STATUS, DSH_VCU_STATUS, 0.1f},
+};
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanOutbox outboxes[CAN_PLAN_MAX_OUTBOXES];
+
+static void test_printReport(const char *name, const CanPlanReport *report) {
+  printf("%s: %u outboxes, %u slots, peak %u frames (average %.2f), peak utilisation %.2f, "
+         "worst queue delay %.0f us\n", name, (unsigned) report->outboxCount, (unsigned) report->slotCount,
+         (unsigned) report->peakFrames, report->averageFrames, report->peakUtilisation,
+         report->worstQueueDelay * 1e6);
+}
+
+int main() {
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  uint32_t outboxCount = 0;
+  for (const TestOutboxRange &range : outboxRanges) {
+    can_busAddOutboxes(&bus, range.idLow, range.idHigh, range.period, outboxes + outboxCount);
+    outboxCount += range.idHigh - range.idLow + 1;
+  }
+  CHECK(outboxCount <= CAN_PLAN_MAX_OUTBOXES);
+  for (uint32_t i = 0; i < outboxCount; i++) {
+    outboxes[i].dlc = 8; // plan for full frames
+  }
+  CHECK(bus.outboxes.size() == outboxCount);
+
+  CanPlanReport unplanned;
+  CanPlanReport planned;
+  CHECK(can_evaluatePhases(&bus, TEST_TICK, TEST_BITRATE, &unplanned) == 0);
+  CHECK(can_planPhases(&bus, TEST_TICK, TEST_BITRATE, &planned) == 0);
+  test_printReport("unplanned", &unplanned);
+  test_printReport("planned", &planned);
+
+  CHECK(planned.outboxCount == outboxCount);
+  CHECK(planned.peakFrames <= TEST_MAX_PEAK_FRAMES);
+  CHECK(planned.worstQueueDelay <= TEST_MAX_QUEUE_DELAY);
+  CHECK(planned.peakUtilisation <= 1.0f);
+  CHECK(planned.peakFrames <= unplanned.peakFrames);
+  CHECK(planned.worstQueueDelay <= unplanned.worstQueueDelay);
+
+  // evaluating the planned phases again reports the same schedule
+  CanPlanReport again;
+  CHECK(can_evaluatePhases(&bus, TEST_TICK, TEST_BITRATE, &again) == 0);
+  CHECK(again.peakFrames == planned.peakFrames);
+  CHECK_NEAR(again.worstQueueDelay, planned.worstQueueDelay, 1e-9);
+  return HOST_TEST_RESULT;
+}
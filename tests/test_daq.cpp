@@ -0,0 +1,182 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "daq.h"
+
+#include <string.h>
+
+/**
+ * Configure a DAQ list over DAQ_VCU_COMMAND from a host tool on a connected bus and check the acknowledgements,
+ * the address validation and how the list is packed into VCU_DAQ_DATA frames.
+ */
+
+#define TEST_TICK 0.001f
+
+typedef struct Signals {
+  float speed;
+  uint16_t rpm;
+  uint32_t odometer;
+  int8_t temperature;
+} Signals;
+
+static HostCanHandle vcuHandle;
+static HostCanHandle toolHandle;
+static CanBus vcuBus;
+static CanBus toolBus;
+static CanInbox responseInbox;
+static Signals signals;
+static uint32_t secret = 0xDEADBEEF; // not in a readable range
+static uint8_t block[6 * DAQ_FRAME_PAYLOAD]; // a list of more frames than bxCAN has mailboxes
+static uint8_t flag = 0x5A;
+
+static void test_tick() {
+  can_busPeriodic(&vcuBus, TEST_TICK);
+  daq_periodic(TEST_TICK);
+  can_busPeriodic(&toolBus, TEST_TICK);
+}
+
+/**
+ * Send one command from the tool and return the status byte of the acknowledgement, -1 if none arrived.
+ */
+static int32_t test_command(const uint8_t *command, uint8_t dlc) {
+  uint32_t before = can_getInboxSequence(&responseInbox);
+  can_busSend(&toolBus, DAQ_VCU_COMMAND, dlc, command);
+  test_tick();
+  CanFrame response;
+  can_readInbox(&responseInbox, &response);
+  if (can_getInboxSequence(&responseInbox) == before || response.dlc != 3 || response.data[0] != command[0] ||
+      response.data[1] != command[1]) {
+    return -1;
+  }
+  return response.data[2];
+}
+
+static int32_t test_addEntry(uint8_t list, const void *variable, uint8_t size) {
+  uint32_t address = daq_getAddress(variable);
+  uint8_t command[7] = {DAQ_CMD_ADD_ENTRY, list, size, (uint8_t) address, (uint8_t) (address >> 8),
+                        (uint8_t) (address >> 16), (uint8_t) (address >> 24)};
+  return test_command(command, 7);
+}
+
+int main() {
+  host_canReset(&vcuHandle);
+  host_canReset(&toolHandle);
+  host_canConnect(&vcuHandle, &toolHandle);
+  host_canConnect(&toolHandle, &vcuHandle);
+  can_busInit(&vcuBus, &vcuHandle);
+  can_busInit(&toolBus, &toolHandle);
+  can_busAddInbox(&toolBus, VCU_DAQ_RESPONSE, &responseInbox);
+  CHECK(daq_init(&vcuBus) == 0);
+
+  signals = {12.5f, 0x1234, 0x89ABCDEF, -40};
+
+  // nothing is readable until a range is registered
+  CHECK(test_addEntry(0, &signals.speed, 4) == 1);
+  CHECK(daq_addReadableRange(&signals, sizeof(signals)) == 0);
+  CHECK(daq_addReadableRange(&signals, 0) == 1);
+
+  uint8_t clear[2] = {DAQ_CMD_CLEAR, 0};
+  CHECK(test_command(clear, 2) == 0);
+  CHECK(test_addEntry(0, &signals.speed, 4) == 0);
+  CHECK(test_addEntry(0, &signals.rpm, 2) == 0);
+  CHECK(test_addEntry(0, &signals.odometer, 4) == 0);
+  CHECK(test_addEntry(0, &signals.temperature, 1) == 0);
+
+  // outside every range, or running past the end of one
+  CHECK(test_addEntry(0, &secret, 4) == 1);
+  CHECK(test_addEntry(0, (const uint8_t *) &signals + sizeof(signals) - 2, 4) == 1);
+  CHECK(daq_getList(0)->entryCount == 4);
+  CHECK(daq_getList(0)->byteCount == 11);
+  CHECK(daq_getList(0)->frameCount == 2);
+
+  uint8_t period[4] = {DAQ_CMD_SET_PERIOD, 0, 10, 0}; // 10 ms
+  CHECK(test_command(period, 4) == 0);
+  uint8_t start[2] = {DAQ_CMD_START, 0};
+  host_canSetTxLogging(&vcuHandle, true);
+  CHECK(test_command(start, 2) == 0);
+
+  // skip the acknowledgement in the log, then run until the list has been sampled once
+  HostCanFrame frame;
+  while (host_canPopTx(&vcuHandle, &frame) == 0) {
+  }
+  for (uint32_t i = 0; i < 10; i++) {
+    test_tick();
+  }
+
+  uint8_t expected[11];
+  memcpy(expected, &signals.speed, 4);
+  memcpy(expected + 4, &signals.rpm, 2);
+  memcpy(expected + 6, &signals.odometer, 4);
+  memcpy(expected + 10, &signals.temperature, 1);
+
+  CHECK(host_canPopTx(&vcuHandle, &frame) == 0);
+  CHECK(frame.id == VCU_DAQ_DATA);
+  CHECK(frame.dlc == 8);
+  CHECK(frame.data[0] == 0x00); // list 0, frame 0
+  CHECK(memcmp(frame.data + 1, expected, 7) == 0);
+  CHECK(host_canPopTx(&vcuHandle, &frame) == 0);
+  CHECK(frame.id == VCU_DAQ_DATA);
+  CHECK(frame.dlc == 5);
+  CHECK(frame.data[0] == 0x01); // list 0, frame 1
+  CHECK(memcmp(frame.data + 1, expected + 7, 4) == 0);
+  CHECK(host_canPopTx(&vcuHandle, &frame) == 1);
+
+  // the next sample picks up new values
+  signals.rpm = 0x4321;
+  for (uint32_t i = 0; i < 10; i++) {
+    test_tick();
+  }
+  CHECK(host_canPopTx(&vcuHandle, &frame) == 0);
+  CHECK(frame.data[5] == 0x21 && frame.data[6] == 0x43);
+
+  uint8_t stop[2] = {DAQ_CMD_STOP, 0};
+  CHECK(test_command(stop, 2) == 0);
+  CHECK(!daq_getList(0)->isRunning);
+
+  // a 6 frame list on a bus that only takes 2 frames per tick: the frames are spread over several calls
+  // instead of overflowing the FIFO (bxCAN has 3 mailboxes), and the list after it still gets its turn
+  for (uint32_t i = 0; i < sizeof(block); i++) {
+    block[i] = (uint8_t) (i + 1);
+  }
+  CHECK(daq_addEntry(1, block, sizeof(block)) == 0);
+  CHECK(daq_addEntry(2, &flag, 1) == 0);
+  CHECK(daq_getList(1)->frameCount == 6);
+  CHECK(daq_setPeriod(1, 0.02f) == 0 && daq_setPeriod(2, 0.02f) == 0);
+  while (host_canPopTx(&vcuHandle, &frame) == 0) {
+  }
+  host_canSetManualTx(&vcuHandle, true);
+  CHECK(daq_start(1) == 0 && daq_start(2) == 0);
+
+  uint32_t blockFrames = 0;
+  uint32_t flagFrames = 0;
+  for (uint32_t i = 0; i < 30; i++) { // one sample of each list, the next one is not due yet
+    can_busPeriodic(&vcuBus, TEST_TICK);
+    CHECK(daq_periodic(TEST_TICK) == 0);
+    host_canFlushTx(&vcuHandle, 2);
+    while (host_canPopTx(&vcuHandle, &frame) == 0) {
+      CHECK(frame.id == VCU_DAQ_DATA);
+      if (frame.data[0] >> 4 == 1) {
+        CHECK(frame.data[0] == (0x10 | blockFrames));
+        CHECK(frame.dlc == 8 && memcmp(frame.data + 1, block + blockFrames * DAQ_FRAME_PAYLOAD, 7) == 0);
+        blockFrames++;
+      } else {
+        CHECK(frame.data[0] == 0x20 && frame.dlc == 2 && frame.data[1] == 0x5A);
+        flagFrames++;
+      }
+    }
+  }
+  CHECK(blockFrames == 6);
+  CHECK(flagFrames == 1);
+  CHECK(daq_getList(1)->overruns == 0);
+
+  // nothing leaves the FIFO for a while: the list is still being sent when it is due again
+  for (uint32_t i = 0; i < 50; i++) {
+    CHECK(daq_periodic(TEST_TICK) == 0);
+  }
+#ifdef STM32L431xx
+  CHECK(daq_getList(1)->overruns > 0);
+#endif
+  host_canSetManualTx(&vcuHandle, false);
+  daq_stop(1);
+  daq_stop(2);
+  return HOST_TEST_RESULT;
+}
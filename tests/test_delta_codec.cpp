@@ -0,0 +1,209 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "delta_codec.h"
+
+#include <string.h>
+
+/**
+ * Blocks too wide for one frame are sent exactly, in parts: check the part encoding on its own, then an
+ * encoder and decoder on connected buses with cell voltages spread over 550 mV and over the full 16 bits,
+ * an encoder that runs faster than the decoder polls, and a keyframe paced through a bus that is slower than it.
+ */
+
+#define CELLS 140
+#define BLOCK 8
+#define BLOCKS ((CELLS + BLOCK - 1) / BLOCK)
+#define TICK 0.01f
+
+static uint32_t testRandom = 0x2468ACE1;
+
+static uint32_t test_random() {
+  testRandom ^= testRandom << 13;
+  testRandom ^= testRandom >> 17;
+  testRandom ^= testRandom << 5;
+  return testRandom;
+}
+
+static HostCanHandle encoderHandle;
+static HostCanHandle decoderHandle;
+static CanBus encoderBus;
+static CanBus decoderBus;
+static CanInbox inboxes[BLOCKS];
+static DeltaEncoder encoder;
+static DeltaDecoder decoder;
+static uint16_t cells[CELLS];
+static uint16_t decoded[CELLS];
+
+static void test_tick() {
+  CHECK(delta_periodic(&encoder, cells, TICK) == 0);
+  can_busPeriodic(&decoderBus, TICK);
+  delta_update(&decoder, decoded);
+}
+
+/**
+ * Tick until the decoder matches the encoder's input.
+ * @return Ticks it took, 100 if it never did
+ */
+static uint32_t test_catchUp() {
+  uint32_t ticks = 0;
+  while (memcmp(cells, decoded, sizeof(cells)) != 0 && ticks < 100) {
+    test_tick();
+    ticks++;
+  }
+  return ticks;
+}
+
+static void test_parts() {
+  uint16_t values[BLOCK];
+  uint16_t result[BLOCK];
+  uint8_t frame[8];
+  for (uint32_t round = 0; round < 1000; round++) {
+    uint16_t spread = (round % 3 == 0) ? 0xFFFF : (round % 3 == 1) ? 550 : 40;
+    for (uint16_t &value : values) {
+      value = (round % 3 == 0) ? (uint16_t) test_random() : 3350 + test_random() % (spread + 1);
+    }
+    memset(result, 0, sizeof(result));
+    uint8_t offset = 0;
+    uint32_t frames = 0;
+    while (offset < BLOCK) {
+      uint8_t count = delta_encodePart(values, BLOCK, offset, false, frame);
+      CHECK(count >= 1 && offset + count <= BLOCK);
+      uint8_t flags = delta_decodeBlock(frame, result, BLOCK);
+      CHECK(flags == DELTA_FLAG_PART);
+      offset += count;
+      frames++;
+    }
+    CHECK(memcmp(values, result, sizeof(values)) == 0);
+    CHECK(frames <= BLOCK / 2);
+  }
+
+  // a part only writes its own values
+  const uint16_t wide[BLOCK] = {0, 65535, 1, 65534, 2, 65533, 3, 65532};
+  uint16_t partial[BLOCK] = {7, 7, 7, 7, 7, 7, 7, 7};
+  uint8_t count = delta_encodePart(wide, BLOCK, 2, true, frame);
+  CHECK(count == 2);
+  CHECK(delta_decodeBlock(frame, partial, BLOCK) == (DELTA_FLAG_PART | DELTA_FLAG_KEYFRAME));
+  CHECK(partial[1] == 7 && partial[2] == 1 && partial[3] == 65534 && partial[4] == 7);
+}
+
+static void test_setUp(float keyframePeriod) {
+  encoderBus = CanBus();
+  decoderBus = CanBus();
+  encoder = DeltaEncoder();
+  decoder = DeltaDecoder();
+  host_canReset(&encoderHandle);
+  host_canReset(&decoderHandle);
+  host_canConnect(&encoderHandle, &decoderHandle);
+  can_busInit(&encoderBus, &encoderHandle);
+  can_busInit(&decoderBus, &decoderHandle);
+  can_busAddInboxes(&decoderBus, HVC_VCU_CELL_VOLTAGES_START, HVC_VCU_CELL_VOLTAGES_START + BLOCKS - 1, inboxes);
+  CHECK(delta_initEncoder(&encoder, &encoderBus, HVC_VCU_CELL_VOLTAGES_START, CELLS, BLOCK, keyframePeriod) == 0);
+  CHECK(delta_initDecoder(&decoder, inboxes, CELLS, BLOCK) == 0);
+  memset(decoded, 0, sizeof(decoded));
+}
+
+static void test_endToEnd(uint16_t low, uint16_t high) {
+  test_setUp(1.0f);
+  for (uint16_t &cell : cells) {
+    cell = low + test_random() % (high - low + 1);
+  }
+  CHECK(test_catchUp() <= BLOCK / 2);
+
+  // random walk: whenever the cells hold still the decoder catches up exactly within a few ticks
+  for (uint32_t step = 0; step < 50; step++) {
+    for (uint32_t t = 0; t < 10; t++) {
+      for (uint16_t &cell : cells) {
+        uint32_t r = test_random();
+        if (r % 100 < 5) {
+          cell += (r & 0x100) ? 1 : -1;
+          cell = (cell < low) ? low : (cell > high) ? high : cell;
+        }
+      }
+      test_tick();
+    }
+    CHECK(test_catchUp() <= BLOCK / 2);
+  }
+  CHECK(decoder.saturatedBlocks == 0);
+
+  // a keyframe resends every value, in parts where needed, even if the decoder lost state
+  memset(decoded, 0, sizeof(decoded));
+  uint32_t framesBefore = encoder.framesSent;
+  for (uint32_t t = 0; t < 100; t++) {
+    test_tick();
+  }
+  CHECK(encoder.framesSent > framesBefore);
+  CHECK(memcmp(cells, decoded, sizeof(cells)) == 0);
+}
+
+/**
+ * Several encoder calls per decoder poll: parts of one block arrive on the same ID before the decoder looks at
+ * it, and each one must still land, or the values stay wrong until the next keyframe.
+ */
+static void test_encoderAhead() {
+  test_setUp(100.0f);
+  for (uint16_t &cell : cells) {
+    cell = 3350 + test_random() % 551;
+  }
+  for (uint32_t round = 0; round < 20; round++) {
+    for (uint32_t call = 0; call < 3; call++) {
+      for (uint16_t &cell : cells) {
+        if (test_random() % 100 < 30) {
+          cell = 3350 + test_random() % 551;
+        }
+      }
+      CHECK(delta_periodic(&encoder, cells, TICK) == 0);
+    }
+    can_busPeriodic(&decoderBus, TICK);
+    delta_update(&decoder, decoded);
+  }
+  CHECK(encoder.partFrames > 0);
+  CHECK(test_catchUp() <= BLOCK / 2); // no keyframe for 100 s
+}
+
+/**
+ * The bus takes 3 frames per tick: the keyframe (one frame per block) is spread over several calls instead of
+ * overflowing the TX FIFO, which on bxCAN would abort the frames already queued.
+ */
+static void test_pacedKeyframe() {
+  test_setUp(1.0f);
+  host_canSetManualTx(&encoderHandle, true);
+  for (uint16_t &cell : cells) {
+    cell = 3690 + test_random() % 21;
+  }
+  uint32_t ticks = 0;
+  while (memcmp(cells, decoded, sizeof(cells)) != 0 && ticks < 100) {
+    CHECK(delta_periodic(&encoder, cells, TICK) == 0);
+    host_canFlushTx(&encoderHandle, 3);
+    can_busPeriodic(&decoderBus, TICK);
+    delta_update(&decoder, decoded);
+    ticks++;
+  }
+  CHECK(ticks <= BLOCKS / 3 + 1);
+  CHECK(encoder.framesSent == BLOCKS);
+  CHECK(encoder._keyframeBlocks == 0);
+
+  // the next keyframe starts on a busy bus and still reaches every block
+  memset(decoded, 0, sizeof(decoded));
+  for (uint32_t t = 0; t < 100 + BLOCKS + 10; t++) { // one frame per tick: the keyframe takes BLOCKS ticks
+    CHECK(delta_periodic(&encoder, cells, TICK) == 0);
+    host_canFlushTx(&encoderHandle, 1);
+    can_busPeriodic(&decoderBus, TICK);
+    delta_update(&decoder, decoded);
+  }
+  CHECK(memcmp(cells, decoded, sizeof(cells)) == 0);
+  host_canSetManualTx(&encoderHandle, false);
+}
+
+int main() {
+  test_parts();
+  test_encoderAhead();
+  test_pacedKeyframe();
+
+  test_endToEnd(3690, 3710);
+  CHECK(encoder.partFrames == 0);
+  test_endToEnd(3350, 3900);
+  CHECK(encoder.partFrames > 0);
+  test_endToEnd(0, 0xFFFF);
+  CHECK(encoder.partFrames > 0);
+  return HOST_TEST_RESULT;
+}
@@ -0,0 +1,125 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_gateway.h"
+
+/**
+ * A gateway on bus A forwards by routing table to buses B and C: each route reaches only its own buses, frames
+ * a full destination cannot take are counted as drops, latency is taken from the RX timestamp (H7), a bus
+ * takes only one gateway, and extended IDs are never forwarded.
+ */
+
+#define TEST_TICK 0.001f
+
+static HostCanHandle handleA;
+static HostCanHandle handleB;
+static HostCanHandle handleC;
+static CanBus busA;
+static CanBus busB;
+static CanBus busC;
+static CanGateway gateway;
+
+/**
+ * Receive one frame on bus A and let the gateway forward it.
+ */
+static void test_receive(uint32_t id) {
+  const uint8_t data[8] = {(uint8_t) id, (uint8_t) (id >> 8), 3, 4, 5, 6, 7, 8};
+  CHECK(host_canInject(&handleA, HOST_CAN_RX_FIFO0, id, 8, data) == 0);
+  can_busPeriodic(&busA, TEST_TICK);
+}
+
+/**
+ * @return Number of frames sent on the handle since the last call, the last one in frame
+ */
+static uint32_t test_popAll(HostCanHandle *handle, HostCanFrame *frame) {
+  uint32_t count = 0;
+  while (host_canPopTx(handle, frame) == 0) {
+    count++;
+  }
+  return count;
+}
+
+int main() {
+  host_canReset(&handleA);
+  host_canReset(&handleB);
+  host_canReset(&handleC);
+  host_canSetTxLogging(&handleB, true);
+  host_canSetTxLogging(&handleC, true);
+  CHECK(can_busInit(&busA, &handleA) == 0);
+  CHECK(can_busInit(&busB, &handleB) == 0);
+  CHECK(can_busInit(&busC, &handleC) == 0);
+
+  CHECK(can_gatewayInit(&gateway, &busA) == 0);
+  CHECK(can_gatewayInit(&gateway, &busA) == 0); // the same gateway again is fine
+  static CanGateway other;
+  CHECK(can_gatewayInit(&other, &busA) == 1);
+  CHECK(busA.gateway == &gateway);
+
+  CHECK(can_gatewayAddRoute(&gateway, 0x100, 0x10F, &busB) == 0);
+  CHECK(can_gatewayAddRoute(&gateway, 0x108, 0x117, &busC) == 0);
+  CHECK(can_gatewayAddRoute(&gateway, 0x200, 0x1FF, &busB) == 1);
+  CHECK(can_gatewayAddRoute(&gateway, 0x7F0, 0x800, &busB) == 1);
+  CHECK(can_gatewayAddRoute(&gateway, 0x300, 0x300, &busA) == 1); // back onto the source
+  CHECK(gateway.destinationCount == 2);
+  CHECK(gateway.routes[0x100] == 0x1 && gateway.routes[0x10A] == 0x3 && gateway.routes[0x117] == 0x2);
+
+  // each route reaches its own buses only, with the payload untouched
+  HostCanFrame frame;
+  test_receive(0x101);
+  CHECK(test_popAll(&handleB, &frame) == 1 && frame.id == 0x101 && frame.dlc == 8 && frame.data[7] == 8);
+  CHECK(test_popAll(&handleC, &frame) == 0);
+  test_receive(0x10A);
+  CHECK(test_popAll(&handleB, &frame) == 1 && frame.id == 0x10A);
+  CHECK(test_popAll(&handleC, &frame) == 1 && frame.id == 0x10A && frame.data[0] == 0x0A && frame.data[1] == 0x01);
+  test_receive(0x115);
+  CHECK(test_popAll(&handleB, &frame) == 0);
+  CHECK(test_popAll(&handleC, &frame) == 1 && frame.id == 0x115);
+  test_receive(0x300);
+  CHECK(test_popAll(&handleB, &frame) == 0 && test_popAll(&handleC, &frame) == 0);
+  CHECK(gateway.stats.forwarded == 4 && gateway.stats.dropped == 0);
+
+  // extended IDs have no place in the table, even when their low bits match a route
+  test_receive(0x18FF0101);
+  CHECK(test_popAll(&handleB, &frame) == 0 && test_popAll(&handleC, &frame) == 0);
+  CHECK(gateway.stats.forwarded == 4);
+
+  // B's TX FIFO fills up: what does not fit is counted as dropped, C is not affected
+  can_gatewayResetStats(&gateway);
+  host_canSetManualTx(&handleB, true);
+  for (uint32_t i = 0; i < HOST_CAN_TX_FIFO_DEPTH + 1; i++) {
+    uint8_t data[8] = {(uint8_t) i};
+    CHECK(host_canInject(&handleA, HOST_CAN_RX_FIFO0, 0x10C, 8, data) == 0);
+  }
+  can_busPeriodic(&busA, TEST_TICK);
+  CHECK(gateway.stats.forwarded == 2 * HOST_CAN_TX_FIFO_DEPTH + 1); // every one reached C
+  CHECK(gateway.stats.dropped == 1);
+  CHECK(test_popAll(&handleC, &frame) == HOST_CAN_TX_FIFO_DEPTH + 1);
+#ifdef H7_SERIES
+  CHECK(host_canFlushTx(&handleB, 100) == HOST_CAN_TX_FIFO_DEPTH);
+  CHECK(test_popAll(&handleB, &frame) == HOST_CAN_TX_FIFO_DEPTH && frame.data[0] == HOST_CAN_TX_FIFO_DEPTH - 1);
+#else
+  host_canFlushTx(&handleB, 100);
+  test_popAll(&handleB, &frame);
+#endif
+  host_canSetManualTx(&handleB, false);
+
+  // latency: from the RX timestamp to the moment the frame is queued, in timestamp counter ticks
+  can_gatewayResetStats(&gateway);
+  CHECK(can_gatewayGetAverageLatency(&gateway) == 0);
+#ifdef H7_SERIES
+  host_canSetTimestamp(&handleA, 100);
+  test_receive(0x101); // forwarded right away, 0 ticks
+  host_canSetTimestamp(&handleA, 0xFFF0);
+  uint8_t data[8] = {};
+  host_canInject(&handleA, HOST_CAN_RX_FIFO0, 0x102, 8, data);
+  host_canSetTimestamp(&handleA, 0x0010); // the 16-bit counter wrapped while the frame waited
+  can_busPeriodic(&busA, TEST_TICK);
+  CHECK(gateway.stats.latencySamples == 2);
+  CHECK(gateway.stats.latencyLast == 0x20);
+  CHECK(gateway.stats.latencyMax == 0x20);
+  CHECK_NEAR(can_gatewayGetAverageLatency(&gateway), 16.0, 1e-6);
+#else
+  test_receive(0x101);
+  CHECK(gateway.stats.forwarded == 1 && gateway.stats.latencySamples == 0); // bxCAN has no timestamp counter
+#endif
+  return HOST_TEST_RESULT;
+}
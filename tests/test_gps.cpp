@@ -0,0 +1,149 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "angel_can.h"
+#include "gps.h"
+#include "faults.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Replay NMEA through the UART DMA stand-in and gps_periodic: sentences split across calls and across the end
+ * of the circular buffer, the fix in 1e-7 degrees, the GPS_FRAME_1..3 payloads, and the fault bits for
+ * corrupted input and a silent receiver.
+ */
+
+#define BUFFER_SIZE 128 // a bit more than one sentence, so the DMA wraps all the time
+#define TICK 0.01f
+
+static HostCanHandle handle;
+static DMA_HandleTypeDef dma;
+static UART_HandleTypeDef uart;
+static uint8_t buffer[BUFFER_SIZE];
+
+/**
+ * Receive "$<body>*<checksum>\r\n" in pieces of at most chunk bytes, running gps_periodic after each.
+ * @param corrupt Added to the checksum, 0 for a valid sentence
+ */
+static void test_sentence(const char *body, uint32_t chunk, uint8_t corrupt = 0) {
+  uint8_t checksum = 0;
+  for (const char *c = body; *c != 0; c++) {
+    checksum ^= (uint8_t) *c;
+  }
+  char sentence[GPS_MAX_SENTENCE + 16];
+  int length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, (uint8_t) (checksum + corrupt));
+  for (int sent = 0; sent < length; sent += (int) chunk) {
+    uint32_t size = (length - sent < (int) chunk) ? (uint32_t) (length - sent) : chunk;
+    host_uartReceive(&uart, (const uint8_t *) sentence + sent, size);
+    gps_periodic(TICK);
+  }
+}
+
+/**
+ * Send the GPS outboxes and return the frame with the given ID.
+ */
+static HostCanFrame test_frame(uint32_t id) {
+  HostCanFrame frame = {};
+  HostCanFrame found = {};
+  can_periodic(1.0f); // every outbox is due
+  while (host_canPopTx(&handle, &frame) == 0) {
+    if (frame.id == id) {
+      found = frame;
+    }
+  }
+  CHECK(found.id == id && found.dlc == 8);
+  return found;
+}
+
+static int32_t test_int32(const HostCanFrame &frame, uint8_t start) {
+  int32_t value;
+  memcpy(&value, frame.data + start, sizeof(value));
+  return value;
+}
+
+static int32_t test_int16(const HostCanFrame &frame, uint8_t start, bool isSigned) {
+  uint16_t value;
+  memcpy(&value, frame.data + start, sizeof(value));
+  return isSigned ? (int16_t) value : value;
+}
+
+int main() {
+  host_canReset(&handle);
+  host_canSetTxLogging(&handle, true);
+  CHECK(can_init(&handle) == 0);
+  uart.hdmarx = &dma;
+  gps_init(&uart, buffer, BUFFER_SIZE, 0.1f);
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_GPS_NO_DMA_START));
+
+  // RMC in 7 byte pieces: crosses the end of the DMA buffer on the second sentence
+  test_sentence("GPRMC,123519.250,A,3016.8421,N,09744.2134,W,022.4,084.4,230394,003.1,W", 7);
+  const GpsData *data = gps_getData();
+  CHECK(data->isValid);
+  CHECK(data->latitude == 302807016); // 30 deg 16.8421'
+  CHECK(data->longitude == -977368900); // 97 deg 44.2134' W
+  CHECK_NEAR(data->speed, 22.4 * 0.514444, 1e-4);
+  CHECK_NEAR(data->heading, 84.4, 1e-4);
+  CHECK(data->hour == 12 && data->minute == 35 && data->second == 19 && data->millis == 250);
+  CHECK(data->day == 23 && data->month == 3 && data->year == 94);
+
+  test_sentence("GPGGA,123520.000,3016.8430,N,09744.2100,W,1,08,0.9,545.4,M,46.9,M,,", 13);
+  CHECK(data->latitude == 302807166);
+  CHECK(data->longitude == -977368333);
+  CHECK(data->fixQuality == 1 && data->satellites == 8);
+  CHECK_NEAR(data->altitude, 545.4, 1e-4);
+  CHECK(data->second == 20 && data->millis == 0);
+
+  // all at once, the write position having wrapped several times by now
+  test_sentence("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K", 200);
+  CHECK_NEAR(data->heading, 54.7, 1e-4);
+  CHECK_NEAR(data->speed, 10.2 / 3.6, 1e-4);
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX | FAULT_VCU_GPS_TIMEOUT));
+
+  HostCanFrame frame1 = test_frame(GPS_FRAME_1);
+  CHECK(test_int32(frame1, 0) == 302807166);
+  CHECK(test_int32(frame1, 4) == -977368333);
+  HostCanFrame frame2 = test_frame(GPS_FRAME_2);
+  CHECK(abs(test_int16(frame2, 0, false) - 283) <= 1); // 0.01 m/s
+  CHECK(abs(test_int16(frame2, 2, false) - 5470) <= 1); // 0.01 degrees
+  CHECK(frame2.data[4] == 12 && frame2.data[5] == 35 && frame2.data[6] == 20 && frame2.data[7] == 94);
+  HostCanFrame frame3 = test_frame(GPS_FRAME_3);
+  CHECK(frame3.data[0] == 3 && frame3.data[1] == 23);
+  CHECK(test_int16(frame3, 2, false) == 0); // millis
+  CHECK(frame3.data[4] == 1 && frame3.data[5] == 8);
+  CHECK(abs(test_int16(frame3, 6, true) - 5454) <= 1); // 0.1 m
+
+  // a bad checksum is reported and leaves the fix alone, the next good sentence clears the fault
+  test_sentence("GPRMC,123521.000,A,0000.0000,S,00000.0000,E,000.0,000.0,240394,,", 5, 1);
+  CHECK(FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX));
+  CHECK(data->latitude == 302807166 && data->day == 23);
+  test_sentence("GPRMC,123521.000,A,3016.8421,S,09744.2134,E,000.0,000.0,240394,,", 9);
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX));
+  CHECK(data->latitude == -302807016 && data->longitude == 977368900 && data->day == 24);
+
+  // garbage without a checksum, then a sentence longer than NMEA allows
+  const char garbage[] = "$GPGGA,1,2,3\r\n";
+  host_uartReceive(&uart, (const uint8_t *) garbage, sizeof(garbage) - 1);
+  gps_periodic(TICK);
+  CHECK(FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX));
+  test_sentence("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K", 200);
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX));
+  char longBody[GPS_MAX_SENTENCE + 1];
+  memset(longBody, '1', sizeof(longBody) - 1);
+  longBody[sizeof(longBody) - 1] = 0;
+  memcpy(longBody, "GPGGA,", 6);
+  test_sentence(longBody, 40);
+  CHECK(FAULT_CHECK(&faultVector, FAULT_VCU_GPS_BAD_RX));
+  CHECK(data->satellites == 8);
+
+  // silence: the timeout is raised and the DMA restarted from the start of the buffer
+  for (uint32_t i = 0; i < (uint32_t) (GPS_TIMEOUT / TICK) + 2; i++) {
+    gps_periodic(TICK);
+  }
+  CHECK(FAULT_CHECK(&faultVector, FAULT_VCU_GPS_TIMEOUT));
+  CHECK(dma.NDTR == BUFFER_SIZE);
+  test_sentence("GPGGA,123530.500,3016.8421,N,09744.2134,W,2,11,0.8,550.0,M,46.9,M,,", 11);
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_GPS_TIMEOUT | FAULT_VCU_GPS_BAD_RX));
+  CHECK(data->fixQuality == 2 && data->satellites == 11 && data->millis == 500);
+  return HOST_TEST_RESULT;
+}
@@ -0,0 +1,180 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_gateway.h"
+#include "isotp.h"
+#include "daq.h"
+
+/**
+ * Frames in the immediate band are handled from the RX FIFO 1 interrupt: they only leave a sequence behind, and
+ * can_busPeriodic restarts the age and clears the timeout. Components that send from their handlers or keep
+ * main loop state are refused IDs in the band. The band only takes its own filter slot: the application's
+ * filters and global filter are left as they were.
+ */
+
+#define BAND_LOW 0x010
+#define BAND_HIGH 0x017 // aligned power-of-two block, valid on both families
+#define FAST_ID 0x012
+#define SLOW_ID 0x100
+
+static HostCanHandle handle;
+static HostCanHandle otherHandle;
+static CanBus bus;
+static CanBus otherBus;
+static CanInbox fastInbox;
+static CanInbox slowInbox;
+static CanGateway gateway;
+static IsoTpChannel channel;
+static uint32_t handlerCalls = 0;
+
+static void test_onFast(CanInbox *inbox, void *context) {
+  (void) inbox;
+  (void) context;
+  handlerCalls++;
+}
+
+static void test_onFastCounted(CanInbox *inbox, void *context) {
+  (void) inbox;
+  (*static_cast<uint32_t *>(context))++;
+}
+
+/**
+ * What the application sets up before can_busInit: filter 1 takes 0x100-0x1FF into FIFO 0, anything else is
+ * rejected.
+ */
+static void test_configureApplicationFilters(HostCanHandle *canHandle) {
+#ifdef H7_SERIES
+  FDCAN_FilterTypeDef filter = {};
+  filter.IdType = FDCAN_STANDARD_ID;
+  filter.FilterIndex = 1;
+  filter.FilterType = FDCAN_FILTER_RANGE;
+  filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
+  filter.FilterID1 = 0x100;
+  filter.FilterID2 = 0x1FF;
+  CHECK(HAL_FDCAN_ConfigFilter(canHandle, &filter) == HAL_OK);
+  CHECK(HAL_FDCAN_ConfigGlobalFilter(canHandle, FDCAN_REJECT, FDCAN_REJECT, FDCAN_REJECT_REMOTE,
+                                     FDCAN_REJECT_REMOTE) == HAL_OK);
+#endif
+#ifdef STM32L431xx
+  CAN_FilterTypeDef filter = {};
+  filter.FilterBank = 1;
+  filter.FilterMode = CAN_FILTERMODE_IDMASK;
+  filter.FilterScale = CAN_FILTERSCALE_32BIT;
+  filter.FilterIdHigh = 0x100 << 5;
+  filter.FilterMaskIdHigh = 0x700 << 5;
+  filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+  filter.FilterActivation = CAN_FILTER_ENABLE;
+  CHECK(HAL_CAN_ConfigFilter(canHandle, &filter) == HAL_OK);
+#endif
+}
+
+/**
+ * The band's filter has to fit the peripheral, and can_busInit reports it when it does not.
+ */
+static void test_invalidFilter() {
+  CanBus invalid;
+  CHECK(can_busSetImmediateBand(&invalid, BAND_LOW, BAND_HIGH, 128) == 1);
+#ifdef H7_SERIES
+  host_canReset(&handle);
+  handle.Init.StdFiltersNbr = 1;
+  CHECK(can_busSetImmediateBand(&invalid, BAND_LOW, BAND_HIGH, 1) == 0);
+  CHECK(can_busInit(&invalid, &handle) == HAL_ERROR);
+
+  invalid = CanBus();
+  host_canReset(&handle);
+  handle.Init.RxFifo1ElmtsNbr = 0;
+  CHECK(can_busSetImmediateBand(&invalid, BAND_LOW, BAND_HIGH, 0) == 0);
+  CHECK(can_busInit(&invalid, &handle) == HAL_ERROR);
+#endif
+#ifdef STM32L431xx
+  CHECK(can_busSetImmediateBand(&invalid, BAND_LOW, BAND_HIGH, 14) == 1);
+  CHECK(can_busSetImmediateBand(&invalid, BAND_LOW, BAND_HIGH + 1, 0) == 1); // not a power-of-two block
+#endif
+}
+
+int main() {
+  test_invalidFilter();
+
+  host_canReset(&handle);
+  host_canReset(&otherHandle);
+  test_configureApplicationFilters(&handle);
+  CHECK(can_busSetImmediateBand(&bus, BAND_LOW, BAND_HIGH, 0) == 0);
+  CHECK(can_busInit(&bus, &handle) == HAL_OK);
+  CHECK(can_busInit(&otherBus, &otherHandle) == HAL_OK);
+  CHECK(can_busIsImmediate(&bus, FAST_ID));
+  CHECK(!can_busIsImmediate(&bus, SLOW_ID));
+  CHECK(!can_busIsImmediate(&otherBus, FAST_ID));
+
+  can_busAddInbox(&bus, FAST_ID, &fastInbox, 0.05f);
+  can_busAddInbox(&bus, SLOW_ID, &slowInbox);
+  CHECK(can_setInboxHandler(&fastInbox, test_onFast, nullptr) == 0);
+
+  // components that would run from the interrupt are refused
+  CHECK(can_gatewayInit(&gateway, &bus) == 0);
+  CHECK(can_gatewayAddRoute(&gateway, BAND_HIGH, SLOW_ID, &otherBus) == 1);
+  CHECK(can_gatewayAddRoute(&gateway, BAND_HIGH + 1, SLOW_ID, &otherBus) == 0);
+  CHECK(isotp_init(&channel, &bus, 0x700, FAST_ID, 0, 0) == 1);
+  CHECK(daq_init(&bus, BAND_LOW, 0x701, 0x702) == 1);
+
+  // band frames land in FIFO 1, the application's filters still decide about the rest
+  const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  CHECK(host_canReceive(&handle, FAST_ID, 8, data) == HOST_CAN_RX_FIFO1);
+  CHECK(host_canReceive(&handle, SLOW_ID, 8, data) == HOST_CAN_RX_FIFO0);
+  CHECK(host_canReceive(&handle, 0x300, 8, data) == -1);
+
+  // the interrupt stores the frame and runs the handler, but leaves age and timeout to the main loop
+  fastInbox.ageSinceRx = 1.0f;
+  fastInbox.isTimeout = true;
+  can_busHandleRxInterrupt(&bus);
+  CHECK(handlerCalls == 1);
+  CHECK(fastInbox.isRecent);
+  CHECK(fastInbox.data[7] == 8);
+  CHECK(fastInbox.ageSinceRx == 1.0f && fastInbox.isTimeout);
+  CHECK(!slowInbox.isRecent);
+
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(slowInbox.isRecent);
+  CHECK_NEAR(fastInbox.ageSinceRx, 0.01, 1e-6);
+  CHECK(!fastInbox.isTimeout);
+  CHECK(fastInbox.isRecent);
+
+  // no new frame: the inbox ages out
+  for (uint32_t i = 0; i < 5; i++) {
+    can_busPeriodic(&bus, 0.01f);
+  }
+  CHECK(fastInbox.isTimeout);
+  CHECK(!fastInbox.isRecent);
+
+  // a frame from the interrupt brings it back on the next call
+  CHECK(host_canReceive(&handle, FAST_ID, 8, data) == HOST_CAN_RX_FIFO1);
+  can_busHandleRxInterrupt(&bus);
+  CHECK(fastInbox.isRecent);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(!fastInbox.isTimeout);
+  CHECK(fastInbox.isRecent);
+  CHECK(handlerCalls == 2);
+
+  can_busEnableDispatchTiming(&bus);
+#ifdef H7_SERIES
+  CHECK(DWT->LAR == 0xC5ACCE55);
+#endif
+  CHECK(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk);
+  CHECK(host_canReceive(&handle, FAST_ID, 8, data) == HOST_CAN_RX_FIFO1);
+  can_busHandleRxInterrupt(&bus);
+  CHECK(bus.dispatchStats.count == 1);
+
+  // a replaced handler gets its own context, a removed one is not called and its slot is free again
+  uint32_t counted = 0;
+  CHECK(can_setInboxHandler(&fastInbox, test_onFastCounted, &counted) == 0);
+  CHECK(host_canReceive(&handle, FAST_ID, 8, data) == HOST_CAN_RX_FIFO1);
+  can_busHandleRxInterrupt(&bus);
+  CHECK(counted == 1 && handlerCalls == 3);
+  uint8_t slot = fastInbox._handler;
+  CHECK(can_setInboxHandler(&fastInbox, nullptr, nullptr) == 0);
+  CHECK(fastInbox._handler == 0);
+  CHECK(host_canReceive(&handle, FAST_ID, 8, data) == HOST_CAN_RX_FIFO1);
+  can_busHandleRxInterrupt(&bus);
+  CHECK(counted == 1 && handlerCalls == 3);
+  CHECK(can_setInboxHandler(&slowInbox, test_onFast, nullptr) == 0);
+  CHECK(slowInbox._handler == slot);
+  return HOST_TEST_RESULT;
+}
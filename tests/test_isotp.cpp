@@ -0,0 +1,76 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "isotp.h"
+
+/**
+ * Two ISO-TP channels on a connected pair of buses: a transfer to a receiver with a buffer arrives intact,
+ * and a first frame sent to a receiver without one is refused with an overflow flow control right away.
+ */
+
+#define TEST_TICK 0.001f
+#define REQUEST_ID 0x700
+#define RESPONSE_ID 0x708
+
+static HostCanHandle handleA;
+static HostCanHandle handleB;
+static CanBus busA;
+static CanBus busB;
+static IsoTpChannel sender;
+static IsoTpChannel receiver;
+
+static void test_tick() {
+  can_busPeriodic(&busA, TEST_TICK);
+  can_busPeriodic(&busB, TEST_TICK);
+  isotp_periodic(&sender, TEST_TICK);
+  isotp_periodic(&receiver, TEST_TICK);
+}
+
+int main() {
+  host_canReset(&handleA);
+  host_canReset(&handleB);
+  host_canConnect(&handleA, &handleB);
+  host_canConnect(&handleB, &handleA);
+  can_busInit(&busA, &handleA);
+  can_busInit(&busB, &handleB);
+  CHECK(isotp_init(&sender, &busA, REQUEST_ID, RESPONSE_ID) == 0);
+  CHECK(isotp_init(&receiver, &busB, RESPONSE_ID, REQUEST_ID) == 0);
+
+  static uint8_t message[300];
+  for (uint16_t i = 0; i < sizeof(message); i++) {
+    message[i] = (uint8_t) (i * 7);
+  }
+
+  // receiver has no buffer: the first frame is answered with overflow and the sender gives up immediately
+  CHECK(receiver.rxState == ISOTP_RX_IDLE);
+  CHECK(isotp_send(&sender, message, sizeof(message)) == 0);
+  for (uint32_t i = 0; i < 3; i++) {
+    test_tick();
+  }
+  CHECK(sender.txState == ISOTP_TX_ERROR);
+  CHECK(receiver.rxState == ISOTP_RX_IDLE);
+
+  // with a buffer the same message goes through
+  static uint8_t buffer[512];
+  CHECK(isotp_receive(&receiver, buffer, sizeof(buffer)) == 0);
+  CHECK(isotp_send(&sender, message, sizeof(message)) == 0);
+  for (uint32_t i = 0; i < 200 && receiver.rxState != ISOTP_RX_DONE; i++) {
+    test_tick();
+  }
+  CHECK(receiver.rxState == ISOTP_RX_DONE);
+  CHECK(sender.txState == ISOTP_TX_DONE);
+  CHECK(isotp_getRxLength(&receiver) == sizeof(message));
+  bool same = true;
+  for (uint16_t i = 0; i < sizeof(message); i++) {
+    same = same && buffer[i] == message[i];
+  }
+  CHECK(same);
+
+  // a completed message is not overwritten by the next first frame
+  CHECK(isotp_send(&sender, message, 100) == 0);
+  for (uint32_t i = 0; i < 3; i++) {
+    test_tick();
+  }
+  CHECK(sender.txState == ISOTP_TX_ERROR);
+  CHECK(isotp_getRxLength(&receiver) == sizeof(message));
+  return HOST_TEST_RESULT;
+}
@@ -0,0 +1,124 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_latency.h"
+
+/**
+ * Drive the FDCAN timestamp counter by hand through VCU_INV_PARAMS_REQUEST -> INV_VCU_PARAMS_RESPONSE exchanges
+ * and check the queueing and round-trip histograms, including a counter wrap-around, and that a marker reused
+ * before its TX event was read is counted instead of measured. bxCAN has no timestamps, so on the L431 only
+ * check that the monitor is refused.
+ */
+
+#ifdef H7_SERIES
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanLatencyMonitor monitor;
+
+/**
+ * Queue a request at queuedAt, put it on the wire at sentAt and receive the response at respondedAt.
+ */
+static void test_exchange(uint16_t queuedAt, uint16_t sentAt, uint16_t respondedAt) {
+  const uint8_t request[8] = {0x01, 0x02};
+  const uint8_t response[8] = {0x01};
+
+  host_canSetTimestamp(&handle, queuedAt);
+  CHECK(can_busSend(&bus, VCU_INV_PARAMS_REQUEST, 8, request) == 0);
+  host_canSetTimestamp(&handle, sentAt);
+  CHECK(host_canFlushTx(&handle, 1) == 1);
+  can_busPeriodic(&bus, 0.001f); // TX event: request is on the wire
+
+  host_canSetTimestamp(&handle, respondedAt);
+  CHECK(host_canReceive(&handle, INV_VCU_PARAMS_RESPONSE, 8, response) >= 0);
+  can_busPeriodic(&bus, 0.001f);
+}
+
+int main() {
+  host_canReset(&handle);
+  host_canSetManualTx(&handle, true);
+  can_busInit(&bus, &handle);
+  CHECK(can_latencyInit(&monitor, &bus, 1e-6f) == 0);
+  CHECK(can_latencyAddPair(&monitor, VCU_INV_PARAMS_REQUEST, INV_VCU_PARAMS_RESPONSE) == 0);
+  const CanLatencyPair *pair = &monitor.pairs[0];
+
+  // a response before any request is not a round trip
+  const uint8_t response[8] = {};
+  host_canReceive(&handle, INV_VCU_PARAMS_RESPONSE, 8, response);
+  can_busPeriodic(&bus, 0.001f);
+  CHECK(pair->roundTrip.count == 0);
+
+  test_exchange(100, 130, 630); // queued 30 ticks, round trip 500
+  CHECK(monitor.queueing.count == 1);
+  CHECK(monitor.queueing.buckets[5] == 1); // 16-31
+  CHECK(pair->roundTrip.count == 1);
+  CHECK(pair->roundTrip.buckets[9] == 1); // 256-511
+  CHECK(pair->roundTrip.min == 500 && pair->roundTrip.max == 500);
+  CHECK(!pair->isPending);
+
+  test_exchange(1000, 1000, 1001); // straight onto the wire, answered the next tick
+  CHECK(monitor.queueing.buckets[0] == 1);
+  CHECK(pair->roundTrip.buckets[1] == 1);
+
+  test_exchange(65500, 65530, 100); // the counter wraps between request and response: 106 ticks
+  CHECK(monitor.queueing.buckets[5] == 2);
+  CHECK(pair->roundTrip.buckets[7] == 1); // 64-127
+  CHECK(pair->roundTrip.max == 500 && pair->roundTrip.min == 1);
+  CHECK(pair->roundTrip.count == 3);
+  CHECK(pair->roundTrip.total == 500 + 1 + 106);
+  CHECK(monitor.queueing.count == 3);
+  CHECK(monitor.lostEvents == 0);
+  CHECK_NEAR(can_latencyGetAverage(&monitor, &pair->roundTrip), 607e-6 / 3, 1e-9);
+
+  // a second response for the same request is not counted again
+  host_canReceive(&handle, INV_VCU_PARAMS_RESPONSE, 8, response);
+  can_busPeriodic(&bus, 0.001f);
+  CHECK(pair->roundTrip.count == 3);
+
+  // two FIFOs worth of frames go out before the TX events are read: the event FIFO overflows, and the next
+  // frame takes marker 0 while its event is still unread
+  can_latencyReset(&monitor);
+  const uint8_t data[8] = {};
+  for (uint32_t batch = 0; batch < 2; batch++) {
+    for (uint32_t i = 0; i < HOST_CAN_TX_FIFO_DEPTH; i++) {
+      CHECK(can_busSend(&bus, VCU_PDU_COOLING, 8, data) == 0);
+    }
+    CHECK(host_canFlushTx(&handle, HOST_CAN_TX_FIFO_DEPTH) == HOST_CAN_TX_FIFO_DEPTH);
+  }
+  CHECK(monitor.reusedMarkers == 0);
+  CHECK(can_busSend(&bus, VCU_PDU_COOLING, 8, data) == 0);
+  CHECK(monitor.reusedMarkers == 1);
+  can_busPeriodic(&bus, 0.001f);
+  host_canFlushTx(&handle, 1);
+  can_busPeriodic(&bus, 0.001f);
+  CHECK(monitor.queueing.count == HOST_CAN_TX_FIFO_DEPTH - 1);
+  CHECK(monitor.lostEvents == 2); // the old frame's event and the new frame's, neither one is trusted
+
+  // a frame the FIFO refused gives its marker back, so every marker comes around clean
+  can_latencyReset(&monitor);
+  for (uint32_t i = 0; i < HOST_CAN_TX_FIFO_DEPTH; i++) {
+    CHECK(can_busSend(&bus, VCU_PDU_COOLING, 8, data) == 0);
+  }
+  CHECK(can_busSend(&bus, VCU_PDU_COOLING, 8, data) == CAN_SEND_FIFO_FULL);
+  for (uint32_t i = 0; i < 2 * CAN_LATENCY_MARKERS; i++) {
+    host_canFlushTx(&handle, HOST_CAN_TX_FIFO_DEPTH);
+    can_busPeriodic(&bus, 0.001f);
+    CHECK(can_busSend(&bus, VCU_PDU_COOLING, 8, data) == 0);
+  }
+  CHECK(monitor.reusedMarkers == 0 && monitor.lostEvents == 0);
+  return HOST_TEST_RESULT;
+}
+
+#else
+
+int main() {
+  static HostCanHandle handle;
+  static CanBus bus;
+  static CanLatencyMonitor monitor;
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  CHECK(can_latencyInit(&monitor, &bus, 1e-6f) == 1);
+  CHECK(bus.latency == nullptr);
+  return HOST_TEST_RESULT;
+}
+
+#endif
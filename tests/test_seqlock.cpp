@@ -0,0 +1,87 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "angel_can.h"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Stress the inbox seqlock: one thread receives frames through the normal RX path (inject, then
+ * can_busPeriodic dispatches them into the inbox) while reader threads copy the inbox with can_readInbox.
+ * Frame k carries k in every data byte, has a DLC of k % 8 + 1 and is received at bus time k + 1, so a copy
+ * mixing two frames shows up as disagreeing bytes, DLC or time.
+ */
+
+#define FRAME_COUNT 200000
+#define READER_COUNT 3
+#define TEST_ID 0x123
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanInbox inbox;
+static std::atomic<bool> done(false);
+
+static void test_receive() {
+  for (uint32_t k = 0; k < FRAME_COUNT; k++) {
+    uint8_t payload[8];
+    for (uint8_t &byte : payload) {
+      byte = (uint8_t) k;
+    }
+    host_canInject(&handle, HOST_CAN_RX_FIFO0, TEST_ID, k % 8 + 1, payload);
+    can_busPeriodic(&bus, 1.0f);
+  }
+  done.store(true);
+}
+
+static void test_read(uint32_t *torn, uint32_t *distinct) {
+  double lastTime = -1;
+  while (!done.load()) {
+    CanFrame frame;
+    can_readInbox(&inbox, &frame);
+    if (frame.rxTime == 0) {
+      continue; // nothing received yet
+    }
+    uint32_t k = (uint32_t) frame.rxTime - 1;
+    bool consistent = frame.dlc == k % 8 + 1;
+    for (uint8_t i = 0; i < frame.dlc; i++) {
+      consistent = consistent && frame.data[i] == (uint8_t) k;
+    }
+    if (!consistent) {
+      (*torn)++;
+    }
+    if (frame.rxTime != lastTime) {
+      (*distinct)++;
+      lastTime = frame.rxTime;
+    }
+  }
+}
+
+int main() {
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  can_busAddInbox(&bus, TEST_ID, &inbox);
+
+  uint32_t torn[READER_COUNT] = {};
+  uint32_t distinct[READER_COUNT] = {};
+  std::thread readers[READER_COUNT];
+  for (uint32_t i = 0; i < READER_COUNT; i++) {
+    readers[i] = std::thread(test_read, &torn[i], &distinct[i]);
+  }
+  std::thread receiver(test_receive);
+  receiver.join();
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+
+  for (uint32_t i = 0; i < READER_COUNT; i++) {
+    CHECK(torn[i] == 0);
+    CHECK(distinct[i] > 0);
+  }
+
+  CanFrame last;
+  can_readInbox(&inbox, &last);
+  CHECK(last.rxTime == FRAME_COUNT);
+  CHECK(last.dlc == (FRAME_COUNT - 1) % 8 + 1);
+  CHECK(can_getInboxSequence(&inbox) == FRAME_COUNT);
+  return HOST_TEST_RESULT;
+}
@@ -0,0 +1,86 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "can_snapshot.h"
+
+/**
+ * A snapshot reads its inboxes without taking their handler slot: a handler on the same inbox keeps working,
+ * capture only decodes the inboxes the RX path marked dirty, and an inbox feeds only one snapshot.
+ */
+
+#define TEST_SIGNALS(X) \
+  X(packVoltage, HVC_VCU_PACK_STATUS, uint16_t, 0, 0.01f) \
+  X(packCurrent, HVC_VCU_PACK_STATUS, int16_t, 2, 0.01f) \
+  X(lvVoltage, PDU_VCU_LVBAT, uint16_t, 0, 0.001f)
+
+enum { TEST_SIGNALS(CAN_SNAPSHOT_INDEX) TEST_SIGNAL_COUNT };
+static const CanSignal testSignals[] = {TEST_SIGNALS(CAN_SNAPSHOT_SIGNAL)};
+static CanSnapshot<TEST_SIGNAL_COUNT> snapshot;
+static CanSnapshot<TEST_SIGNAL_COUNT> otherSnapshot;
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanInbox packInbox;
+static CanInbox lvInbox;
+static uint32_t handlerCalls = 0;
+
+static void test_onPackStatus(CanInbox *inbox, void *context) {
+  (void) inbox;
+  (void) context;
+  handlerCalls++;
+}
+
+static void test_receive(uint32_t id, uint16_t first, uint16_t second) {
+  uint8_t data[4] = {(uint8_t) first, (uint8_t) (first >> 8), (uint8_t) second, (uint8_t) (second >> 8)};
+  host_canInject(&handle, HOST_CAN_RX_FIFO0, id, 4, data);
+}
+
+int main() {
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  can_busAddInbox(&bus, HVC_VCU_PACK_STATUS, &packInbox, 0.1f);
+  can_busAddInbox(&bus, PDU_VCU_LVBAT, &lvInbox);
+  CHECK(can_setInboxHandler(&packInbox, test_onPackStatus, nullptr) == 0);
+
+  // a frame received before the snapshot existed is picked up by the first capture
+  test_receive(PDU_VCU_LVBAT, 12600, 0);
+  can_busPeriodic(&bus, 0.01f);
+
+  CHECK(can_snapshotInit(&snapshot, &bus, testSignals) == 0);
+  CHECK(can_snapshotCapture(&snapshot) == 1);
+  CHECK_NEAR(snapshot.value[SIGNAL_lvVoltage], 12.6, 0.001);
+  CHECK(!can_snapshotIsValid(&snapshot, SIGNAL_packVoltage));
+
+  test_receive(HVC_VCU_PACK_STATUS, 40000, (uint16_t) -1500);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(handlerCalls == 1);
+  CHECK(can_snapshotCapture(&snapshot) == 1);
+  CHECK_NEAR(snapshot.value[SIGNAL_packVoltage], 400.0, 0.001);
+  CHECK_NEAR(snapshot.value[SIGNAL_packCurrent], -15.0, 0.001);
+  CHECK(can_snapshotIsValid(&snapshot, SIGNAL_packVoltage));
+
+  // nothing new: nothing decoded, values stay put while they age out
+  can_busPeriodic(&bus, 0.2f);
+  CHECK(can_snapshotCapture(&snapshot) == 0);
+  CHECK_NEAR(snapshot.value[SIGNAL_packVoltage], 400.0, 0.001);
+  CHECK(!can_snapshotIsValid(&snapshot, SIGNAL_packVoltage));
+  CHECK(can_snapshotIsValid(&snapshot, SIGNAL_lvVoltage));
+
+  // two frames between captures: one decode, of the latest
+  test_receive(HVC_VCU_PACK_STATUS, 39000, 0);
+  can_busPeriodic(&bus, 0.01f);
+  test_receive(HVC_VCU_PACK_STATUS, 38000, 0);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(handlerCalls == 3);
+  CHECK(can_snapshotCapture(&snapshot) == 1);
+  CHECK_NEAR(snapshot.value[SIGNAL_packVoltage], 380.0, 0.001);
+  CHECK(can_snapshotCapture(&snapshot) == 0);
+
+  // the inboxes are taken; setting up the same snapshot again is fine
+  CHECK(can_snapshotInit(&otherSnapshot, &bus, testSignals) == 1);
+  CHECK(can_snapshotInit(&snapshot, &bus, testSignals) == 0);
+  test_receive(PDU_VCU_LVBAT, 12000, 0);
+  can_busPeriodic(&bus, 0.01f);
+  CHECK(can_snapshotCapture(&snapshot) == 2); // both inboxes hold frames from before the second set-up
+  CHECK_NEAR(snapshot.value[SIGNAL_lvVoltage], 12.0, 0.001);
+  return HOST_TEST_RESULT;
+}
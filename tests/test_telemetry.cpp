@@ -0,0 +1,413 @@
+#include "host_hal.h"
+#include "host_test.h"
+#include "telemetry.h"
+#include "faults.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * Decode the batches the telemetry queue hands out, hold the consumer still to exercise drop-oldest and
+ * downsample (the batch being sent must survive), and deliver everything through AT+QISEND to a TCP server
+ * on the loopback interface standing in for the cloud endpoint.
+ */
+
+#define TICK 0.01f
+#define SCHEMA_PACK 1
+#define SCHEMA_WHEEL 2
+#define MAX_RECORDS 256
+
+typedef struct TestRecord {
+  uint8_t schemaId;
+  uint8_t dlc;
+  uint32_t time; // ms since telemetry_init
+  uint8_t data[8];
+} TestRecord;
+
+typedef struct TestBatch {
+  uint16_t sequence;
+  uint32_t time;
+  uint16_t recordCount;
+  TestRecord records[MAX_RECORDS];
+} TestBatch;
+
+static HostCanHandle handle;
+static CanBus bus;
+static CanInbox packInbox;
+static CanInbox wheelInbox;
+static uint16_t frameCounter = 0;
+
+/**
+ * Parse one batch as the server would.
+ * @return true if the batch is well formed and uses its whole length
+ */
+static bool test_decode(const uint8_t *data, uint16_t length, TestBatch *batch) {
+  if (length < TELEMETRY_HEADER_SIZE || data[0] != TELEMETRY_MAGIC || data[1] != TELEMETRY_VERSION) {
+    return false;
+  }
+  batch->sequence = data[2] | (data[3] << 8);
+  batch->time = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t) data[7] << 24);
+  batch->recordCount = data[8];
+  uint32_t time = batch->time;
+  uint16_t position = TELEMETRY_HEADER_SIZE;
+  for (uint16_t i = 0; i < batch->recordCount; i++) {
+    TestRecord *record = &batch->records[i];
+    if (position + 2 > length) {
+      return false;
+    }
+    record->schemaId = data[position];
+    record->dlc = data[position + 1];
+    position += 2;
+    uint32_t delta = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+      if (position >= length || shift > 28) {
+        return false;
+      }
+      byte = data[position++];
+      delta |= (uint32_t) (byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    time += delta;
+    record->time = time;
+    if (record->dlc > 8 || position + record->dlc > length) {
+      return false;
+    }
+    memcpy(record->data, data + position, record->dlc);
+    position += record->dlc;
+  }
+  return position == length;
+}
+
+/**
+ * Receive a pack status frame (counter in bytes 0-1) every tick and a wheel speed frame every other tick.
+ */
+static void test_tick() {
+  frameCounter++;
+  uint8_t pack[8] = {(uint8_t) frameCounter, (uint8_t) (frameCounter >> 8), 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+  host_canInject(&handle, HOST_CAN_RX_FIFO0, HVC_VCU_PACK_STATUS, 8, pack);
+  if (frameCounter % 2 == 0) {
+    uint8_t wheel[4] = {(uint8_t) frameCounter, (uint8_t) (frameCounter >> 8), 1, 2};
+    host_canInject(&handle, HOST_CAN_RX_FIFO0, UNSFR_VCU_MAGNET, 4, wheel);
+  }
+  can_busPeriodic(&bus, TICK);
+  telemetry_periodic(TICK);
+}
+
+/**
+ * Tick until the condition holds.
+ * @return false if it still did not after maxTicks
+ */
+template<typename Condition>
+static bool test_tickUntil(Condition condition, uint32_t maxTicks) {
+  for (uint32_t t = 0; t < maxTicks && !condition(); t++) {
+    test_tick();
+  }
+  return condition();
+}
+
+static void test_reset(TelemetryPolicy policy) {
+  bus = CanBus();
+  packInbox = CanInbox();
+  wheelInbox = CanInbox();
+  host_canReset(&handle);
+  can_busInit(&bus, &handle);
+  can_busAddInbox(&bus, HVC_VCU_PACK_STATUS, &packInbox);
+  can_busAddInbox(&bus, UNSFR_VCU_MAGNET, &wheelInbox);
+  telemetry_init(policy, 0.5f);
+  CHECK(telemetry_addChannel(SCHEMA_PACK, &packInbox, 0.02f) == 0);
+  CHECK(telemetry_addChannel(SCHEMA_WHEEL, &wheelInbox, 0.05f) == 0);
+}
+
+/**
+ * Every batch decodes, records carry the latest frame of their inbox, and times only move forward.
+ */
+static void test_format() {
+  static TestBatch batch;
+  test_reset(TELEMETRY_DROP_OLDEST);
+  uint16_t startTick = frameCounter;
+  CHECK(test_tickUntil([] { return telemetry_getQueueLength() == 6; }, 400)); // one batch every 0.5 s
+  uint32_t ticks = frameCounter - startTick;
+  CHECK(ticks >= 300 && ticks <= 310);
+  uint32_t lastTime = 0;
+  uint32_t packRecords = 0;
+  uint32_t wheelRecords = 0;
+  for (uint16_t expected = 0; expected < 6; expected++) {
+    const uint8_t *data;
+    uint16_t length;
+    CHECK(telemetry_peekBatch(&data, &length));
+    CHECK(length <= TELEMETRY_BATCH_SIZE);
+    CHECK(test_decode(data, length, &batch));
+    CHECK(batch.sequence == expected);
+    CHECK(batch.time >= lastTime && batch.time >= expected * 500u && batch.time <= expected * 520u);
+    for (uint16_t i = 0; i < batch.recordCount; i++) {
+      const TestRecord &record = batch.records[i];
+      CHECK(record.time >= lastTime && record.time >= batch.time);
+      lastTime = record.time;
+      uint16_t counter = (record.data[0] | (record.data[1] << 8)) - startTick;
+      if (record.schemaId == SCHEMA_PACK) {
+        CHECK(counter == record.time / 10); // the frame of the tick the record was taken in
+        CHECK(record.dlc == 8 && record.data[7] == 0xFF);
+        packRecords++;
+      } else {
+        CHECK(record.schemaId == SCHEMA_WHEEL && record.dlc == 4 && record.data[3] == 2);
+        CHECK(counter <= record.time / 10 && counter + 1u >= record.time / 10); // every other tick
+        wheelRecords++;
+      }
+    }
+    telemetry_popBatch();
+  }
+  CHECK(!telemetry_peekBatch(nullptr, nullptr));
+  CHECK(packRecords == ticks / 2);
+  CHECK(wheelRecords + 1 >= ticks / 5 && wheelRecords <= ticks / 5); // no drift from ticks that overshoot the period
+  CHECK(telemetry_getStats()->records == packRecords + wheelRecords); // the open batch was just queued
+  CHECK(telemetry_getStats()->droppedBatches == 0);
+}
+
+/**
+ * The modem takes one batch and stalls: the queue fills, the oldest batches behind the one being sent are
+ * dropped, and the one being sent is left untouched until it is popped.
+ */
+static void test_dropOldest() {
+  static TestBatch batch;
+  static uint8_t inFlight[TELEMETRY_BATCH_SIZE];
+  test_reset(TELEMETRY_DROP_OLDEST);
+  CHECK(test_tickUntil([] { return telemetry_getQueueLength() == 1; }, 100));
+  const uint8_t *data;
+  uint16_t length;
+  CHECK(telemetry_peekBatch(&data, &length));
+  uint16_t inFlightLength = length;
+  memcpy(inFlight, data, length);
+
+  CHECK(test_tickUntil([] { return telemetry_getStats()->droppedBatches == 4; }, 100 * (TELEMETRY_QUEUE_DEPTH + 4)));
+  CHECK(telemetry_getQueueLength() == TELEMETRY_QUEUE_DEPTH);
+  CHECK(FAULT_CHECK(&faultVector, FAULT_VCU_CELL_QUEUE_FULL));
+  CHECK(length == inFlightLength && memcmp(data, inFlight, length) == 0);
+
+  // the batch being sent, then the newest ones without gaps
+  const uint8_t *again;
+  CHECK(telemetry_peekBatch(&again, &length));
+  CHECK(again == data);
+  CHECK(test_decode(again, length, &batch) && batch.sequence == 0);
+  telemetry_popBatch();
+  CHECK(!FAULT_CHECK(&faultVector, FAULT_VCU_CELL_QUEUE_FULL));
+  uint16_t expected = 5;
+  while (telemetry_peekBatch(&data, &length)) {
+    CHECK(test_decode(data, length, &batch));
+    CHECK(batch.sequence == expected++);
+    telemetry_popBatch();
+  }
+  CHECK(expected == 5 + TELEMETRY_QUEUE_DEPTH - 1);
+}
+
+/**
+ * The modem stalls for good: sample periods stretch to the limit before batches are dropped, and the batch
+ * being sent survives here too.
+ */
+static void test_downsample() {
+  test_reset(TELEMETRY_DOWNSAMPLE);
+  CHECK(test_tickUntil([] { return telemetry_getQueueLength() == 1; }, 100));
+  const uint8_t *data;
+  uint16_t length;
+  CHECK(telemetry_peekBatch(&data, &length));
+  uint16_t sequence = data[2] | (data[3] << 8);
+
+  uint8_t maxDownsample = 0;
+  uint32_t dropsAtFullStretch = 0;
+  for (uint32_t t = 0; t < 50 * 4 * TELEMETRY_QUEUE_DEPTH; t++) {
+    test_tick();
+    uint8_t downsample = telemetry_getStats()->downsample;
+    maxDownsample = (downsample > maxDownsample) ? downsample : maxDownsample;
+    if (telemetry_getStats()->droppedBatches != 0 && dropsAtFullStretch == 0) {
+      dropsAtFullStretch = downsample;
+    }
+  }
+  CHECK(maxDownsample == TELEMETRY_MAX_DOWNSAMPLE);
+  CHECK(dropsAtFullStretch == TELEMETRY_MAX_DOWNSAMPLE);
+  CHECK(telemetry_getQueueLength() == TELEMETRY_QUEUE_DEPTH);
+
+  // at 8x the pack channel is sampled every 160 ms instead of every 20 ms
+  uint32_t records = telemetry_getStats()->records;
+  for (uint32_t t = 0; t < 100; t++) {
+    test_tick();
+  }
+  uint32_t perSecond = telemetry_getStats()->records - records;
+  CHECK(perSecond <= 6 + 3);
+
+  CHECK(telemetry_peekBatch(&data, &length));
+  CHECK((uint16_t) (data[2] | (data[3] << 8)) == sequence);
+
+  // the modem catches up and the stretch comes back off
+  while (telemetry_peekBatch(&data, &length)) {
+    telemetry_popBatch();
+  }
+  for (uint32_t t = 0; t < 50 * 4; t++) {
+    test_tick();
+    while (telemetry_peekBatch(&data, &length)) {
+      telemetry_popBatch();
+    }
+  }
+  CHECK(telemetry_getStats()->downsample == 0);
+}
+
+/**
+ * Read until the delimiter, at most size - 1 bytes.
+ * @return Bytes read, 0 on error
+ */
+static size_t test_readUntil(int socket, char *buffer, size_t size, char delimiter) {
+  size_t count = 0;
+  while (count + 1 < size) {
+    if (recv(socket, buffer + count, 1, 0) != 1) {
+      return 0;
+    }
+    if (buffer[count++] == delimiter) {
+      break;
+    }
+  }
+  buffer[count] = '\0';
+  return count;
+}
+
+static bool test_readExactly(int socket, uint8_t *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    ssize_t received = recv(socket, buffer + count, length - count, 0);
+    if (received <= 0) {
+      return false;
+    }
+    count += (size_t) received;
+  }
+  return true;
+}
+
+/**
+ * The server end: accept one connection, answer every AT+QISEND with "> ", read the payload, decode it and
+ * answer "SEND OK". Stops when the connection closes.
+ */
+static void test_server(int listener, uint32_t *batches, uint32_t *records, bool *isValid) {
+  static TestBatch batch;
+  static uint8_t payload[TELEMETRY_BATCH_SIZE];
+  int connection = accept(listener, nullptr, nullptr);
+  if (connection < 0) {
+    *isValid = false;
+    return;
+  }
+  uint16_t expected = 0;
+  char command[32];
+  while (test_readUntil(connection, command, sizeof(command), '\r') != 0) {
+    unsigned connectId;
+    unsigned length;
+    if (sscanf(command, "AT+QISEND=%u,%u\r", &connectId, &length) != 2 || connectId != 0 ||
+        length == 0 || length > TELEMETRY_BATCH_SIZE) {
+      *isValid = false;
+      break;
+    }
+    send(connection, "> ", 2, 0);
+    if (!test_readExactly(connection, payload, length) || !test_decode(payload, (uint16_t) length, &batch) ||
+        batch.sequence != expected++) {
+      *isValid = false;
+      break;
+    }
+    (*batches)++;
+    *records += batch.recordCount;
+    send(connection, "SEND OK\r\n", 9, 0);
+  }
+  close(connection);
+}
+
+/**
+ * Hand the oldest batch to the server with the command telemetry_formatSendCommand writes, and pop it only once
+ * the server confirmed it.
+ * @return true if a batch was sent
+ */
+static bool test_sendBatch(int modem) {
+  const uint8_t *data;
+  uint16_t length;
+  if (!telemetry_peekBatch(&data, &length)) {
+    return false;
+  }
+  char command[32];
+  uint16_t commandLength = telemetry_formatSendCommand(command, sizeof(command), 0, length);
+  CHECK(commandLength != 0);
+  char reply[16];
+  CHECK(send(modem, command, commandLength, 0) == commandLength);
+  CHECK(test_readExactly(modem, (uint8_t *) reply, 2) && memcmp(reply, "> ", 2) == 0);
+  CHECK(send(modem, data, length, 0) == length);
+  CHECK(test_readUntil(modem, reply, sizeof(reply), '\n') != 0 && strcmp(reply, "SEND OK\r\n") == 0);
+  telemetry_popBatch();
+  return true;
+}
+
+/**
+ * The modem driver gets a turn now and then and sends one batch per turn; at the end the last batch is flushed
+ * and everything recorded must have reached the server.
+ */
+static void test_tcp() {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addressLength = sizeof(address);
+  if (listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 1) != 0 ||
+      getsockname(listener, (sockaddr *) &address, &addressLength) != 0) {
+    printf("no loopback TCP, skipping the server test\n");
+    if (listener >= 0) {
+      close(listener);
+    }
+    return;
+  }
+
+  uint32_t serverBatches = 0;
+  uint32_t serverRecords = 0;
+  bool isValid = true;
+  std::thread server(test_server, listener, &serverBatches, &serverRecords, &isValid);
+  int modem = socket(AF_INET, SOCK_STREAM, 0);
+  if (modem < 0 || connect(modem, (sockaddr *) &address, sizeof(address)) != 0) {
+    CHECK(false);
+    shutdown(listener, SHUT_RDWR); // lets accept return
+    server.join();
+    close(listener);
+    return;
+  }
+
+  test_reset(TELEMETRY_DROP_OLDEST);
+  uint32_t sent = 0;
+  for (uint32_t t = 0; t < 1000; t++) {
+    test_tick();
+    if (t % 7 == 0 && test_sendBatch(modem)) {
+      sent++;
+    }
+  }
+  telemetry_periodic(1.0f); // queue the open batch
+  while (test_sendBatch(modem)) {
+    sent++;
+  }
+  close(modem);
+  server.join();
+  close(listener);
+
+  CHECK(isValid);
+  CHECK(sent >= 20 && serverBatches == sent);
+  CHECK(telemetry_getStats()->droppedBatches == 0);
+  CHECK(serverRecords == telemetry_getStats()->records);
+}
+
+int main() {
+  char command[17];
+  CHECK(telemetry_formatSendCommand(command, sizeof(command), 0, 312) == 16);
+  CHECK(strcmp(command, "AT+QISEND=0,312\r") == 0);
+  CHECK(telemetry_formatSendCommand(command, 16, 0, 312) == 0); // no room for the terminator
+
+  test_format();
+  test_dropOldest();
+  test_downsample();
+  test_tcp();
+  return HOST_TEST_RESULT;
+}